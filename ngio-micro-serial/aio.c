@@ -0,0 +1,281 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/* 
+* This software was developed as part of the                       
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)                 
+* www.nextgenio.eu           
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+/* need this to get O_DIRECT definition */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "utils.h"
+#include "latency.h"
+#include "aio.h"
+
+#ifdef __linux__
+
+#include <sys/syscall.h>
+
+/* Linux AIO through raw syscalls, so libaio is not needed */
+int io_setup(unsigned int nr, aio_context_t *ctx){
+  return syscall(SYS_io_setup, nr, ctx);
+}
+
+int io_destroy(aio_context_t ctx){
+  return syscall(SYS_io_destroy, ctx);
+}
+
+int io_submit(aio_context_t ctx, long nr, struct iocb **iocbs){
+  return syscall(SYS_io_submit, ctx, nr, iocbs);
+}
+
+int io_getevents(aio_context_t ctx, long min_nr, long nr, struct io_event *events, struct timespec *timeout){
+  return syscall(SYS_io_getevents, ctx, min_nr, nr, events, timeout);
+}
+
+/* Point an iocb at a random block of a random file. */
+static void aio_prepare(struct iocb *cb, int *fds, unsigned int files, unsigned long blocks,
+                        unsigned int block_size, int writing){
+
+  cb->aio_lio_opcode = writing ? IOCB_CMD_PWRITE : IOCB_CMD_PREAD;
+  cb->aio_fildes = fds[rand() % files];
+  cb->aio_nbytes = block_size;
+  cb->aio_offset = (long long)(rand() % blocks) * block_size;
+
+}
+
+/*
+ * Keep qd random block reads or writes in flight over the files until
+ * ops have completed, resubmitting as each one finishes. Latency is from
+ * submission to reaping of each request.
+ */
+static int aio_run(aio_context_t ctx, int *fds, unsigned int files, unsigned long blocks,
+                   unsigned int block_size, int writing, unsigned int qd, unsigned long ops,
+                   unsigned char **buffers, struct histogram *lat, double *duration){
+
+  struct iocb cbs[AIO_MAX_QD];
+  struct iocb *cbp[AIO_MAX_QD];
+  struct io_event events[AIO_MAX_QD];
+  struct timespec submitted[AIO_MAX_QD];
+  struct timespec start, end, now;
+  unsigned long issued = 0, done = 0;
+  int i, n, slot;
+
+  memset(cbs, 0, sizeof(cbs));
+
+  clock_gettime(CLOCK, &start);
+
+  for(i=0; i<qd && issued<ops; i++, issued++){
+    cbs[i].aio_data = i;
+    cbs[i].aio_buf = (unsigned long)buffers[i];
+    aio_prepare(&cbs[i], fds, files, blocks, block_size, writing);
+    cbp[i] = &cbs[i];
+    clock_gettime(CLOCK, &submitted[i]);
+  }
+  if(io_submit(ctx, i, cbp) != i){
+    perror("ERROR: io_submit failed in aio_run");
+    return 1;
+  }
+
+  while(done < ops){
+    n = io_getevents(ctx, 1, qd, events, NULL);
+    if(n < 0){
+      if(errno == EINTR) continue;
+      perror("ERROR: io_getevents failed in aio_run");
+      return 1;
+    }
+    clock_gettime(CLOCK, &now);
+
+    for(i=0; i<n; i++){
+      slot = events[i].data;
+      if(events[i].res != block_size){
+        fprintf(stderr, "ERROR: short or failed request (%lld) in aio_run\n", (long long)events[i].res);
+        return 1;
+      }
+      hist_record(lat, time_diff(&submitted[slot], &now));
+      done++;
+
+      if(issued < ops){
+        aio_prepare(&cbs[slot], fds, files, blocks, block_size, writing);
+        cbp[0] = &cbs[slot];
+        clock_gettime(CLOCK, &submitted[slot]);
+        if(io_submit(ctx, 1, cbp) != 1){
+          perror("ERROR: io_submit failed in aio_run");
+          return 1;
+        }
+        issued++;
+      }
+    }
+  }
+
+  clock_gettime(CLOCK, &end);
+  *duration = time_diff(&start, &end);
+
+  return 0;
+}
+
+/*
+ * Asynchronous random block I/O over `files` files of N MB each, opened
+ * with O_DIRECT where the filesystem supports it. Runs at queue depth qd,
+ * or sweeps the powers of two 1..256 if qd is 0, and reports IOPS and
+ * latency percentiles at each depth.
+ */
+int aio_random(unsigned int N, unsigned int files, unsigned int block_size, unsigned int qd,
+               unsigned long reps, int writing){
+
+  aio_context_t ctx;
+  char name[100];
+  char titlebuffer[500];
+  char label[32];
+  unsigned char *buffers[AIO_MAX_QD];
+  unsigned char *data;
+  unsigned long blocks, ops, b;
+  unsigned int i, depth, first, last;
+  struct histogram lat;
+  double duration;
+  int *fds;
+  int fd, direct = 1;
+  char *op = writing ? "aio_write_random" : "aio_read_random";
+
+  if(files == 0) files = 1;
+  if(block_size == 0 || block_size % 512 != 0){
+    fprintf(stderr, "ERROR: block size must be a multiple of 512 bytes in %s\n", op);
+    return 1;
+  }
+  if(qd > AIO_MAX_QD){
+    fprintf(stderr, "ERROR: queue depth is limited to %d in %s\n", AIO_MAX_QD, op);
+    return 1;
+  }
+
+  blocks = ((unsigned long)N << 20) / block_size;
+  if(blocks == 0){
+    fprintf(stderr, "ERROR: files of %u MB hold no %u byte blocks in %s\n", N, block_size, op);
+    return 1;
+  }
+
+  /* default to a fixed number of requests at each depth */
+  ops = (reps == ULONG_MAX) ? 65536 : reps;
+
+  fds = malloc(files * sizeof(int));
+  if(!fds){
+    fprintf(stderr, "ERROR: out of memory in %s\n", op);
+    return 1;
+  }
+  for(i=0; i<AIO_MAX_QD; i++){
+    if(posix_memalign((void **)&buffers[i], 4096, block_size) != 0){
+      fprintf(stderr, "ERROR: out of memory in %s\n", op);
+      return 1;
+    }
+    memset(buffers[i], i, block_size);
+  }
+  data = buffers[0];
+
+  /* create the test files */
+  for(i=0; i<files; i++){
+    sprintf(name, "testfile_%u", i);
+    fd = open(name, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+    if(fd < 0){
+      fprintf(stderr, "ERROR: unable to open test file for writing in %s\n", op);
+      return 1;
+    }
+    for(b=0; b<blocks; b++){
+      write(fd, data, block_size);
+    }
+    fsync(fd);
+    close(fd);
+  }
+
+  /* reopen them for direct I/O, falling back to the page cache if refused */
+  for(i=0; i<files; i++){
+    sprintf(name, "testfile_%u", i);
+    fds[i] = open(name, (writing ? O_RDWR : O_RDONLY) | (direct ? O_DIRECT : 0));
+    if(fds[i] < 0 && errno == EINVAL && i == 0){
+      fprintf(stderr, "WARNING: O_DIRECT not supported here, %s uses buffered I/O\n", op);
+      direct = 0;
+      fds[i] = open(name, writing ? O_RDWR : O_RDONLY);
+    }
+    if(fds[i] < 0){
+      fprintf(stderr, "ERROR: unable to open test file in %s\n", op);
+      return 1;
+    }
+  }
+
+  first = qd ? qd : 1;
+  last = qd ? qd : AIO_MAX_QD;
+
+  sprintf(titlebuffer, "%s: %u files of %u MB, %u byte blocks, %s", op, files, N, block_size,
+          direct ? "O_DIRECT" : "buffered");
+  latency_header(titlebuffer);
+
+  for(depth=first; depth<=last; depth*=2){
+    sprintf(label, "QD %u", depth);
+    hist_reset(&lat, label);
+
+    ctx = 0;
+    if(io_setup(depth, &ctx) != 0){
+      perror("ERROR: io_setup failed");
+      return 1;
+    }
+
+    if(aio_run(ctx, fds, files, blocks, block_size, writing, depth, ops, buffers, &lat, &duration) != 0){
+      io_destroy(ctx);
+      return 1;
+    }
+    io_destroy(ctx);
+
+    latency_row(label, &lat, ops / duration);
+  }
+
+  latency_footer();
+
+  /* clean up the test files */
+  for(i=0; i<files; i++){
+    close(fds[i]);
+    sprintf(name, "testfile_%u", i);
+    unlink(name);
+  }
+
+  for(i=0; i<AIO_MAX_QD; i++){
+    free(buffers[i]);
+  }
+  free(fds);
+  fflush(stdout);
+
+  return 0;
+}
+
+#else
+
+int aio_random(unsigned int N, unsigned int files, unsigned int block_size, unsigned int qd,
+               unsigned long reps, int writing){
+
+  fprintf(stderr, "ERROR: asynchronous I/O benchmarks need Linux AIO\n");
+  return 1;
+
+}
+
+#endif
@@ -0,0 +1,36 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/* 
+* This software was developed as part of the                       
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)                 
+* www.nextgenio.eu           
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+/* Linux AIO system calls for the asynchronous io benchmarks */
+
+/* largest queue depth the io benchmarks use */
+#define AIO_MAX_QD 256
+
+#ifdef __linux__
+
+#include <time.h>
+#include <linux/aio_abi.h>
+
+int io_setup(unsigned int, aio_context_t *);
+int io_destroy(aio_context_t);
+int io_submit(aio_context_t, long, struct iocb **);
+int io_getevents(aio_context_t, long, long, struct io_event *, struct timespec *);
+
+#endif
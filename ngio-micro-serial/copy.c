@@ -0,0 +1,279 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+/* need this to get splice and F_SETPIPE_SZ */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "utils.h"
+#include "latency.h"
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sendfile.h>
+#endif
+
+/*
+ * Ways of copying one file to another:
+ *
+ *   read_write       a read and write loop through a user buffer, for
+ *                    each of the COPY_BUFFERS buffer sizes.
+ *   copy_file_range  in the kernel, which may clone the extents rather
+ *                    than copy them on filesystems that can.
+ *   sendfile         in the kernel, from the page cache of the source.
+ *   splice           in the kernel, from the source into a pipe and from
+ *                    the pipe into the destination.
+ */
+#define COPY_READ_WRITE 0
+#define COPY_FILE_RANGE 1
+#define COPY_SENDFILE 2
+#define COPY_SPLICE 3
+#define NUM_COPY 4
+
+static char *copy_names[NUM_COPY] = {"read_write", "copy_file_range", "sendfile", "splice"};
+
+#define COPY_BUFFERS 4
+static size_t copy_buffers[COPY_BUFFERS] = {4096, 65536, 1UL << 20, 16UL << 20};
+
+/* largest chunk handed to the kernel copies in one call */
+#define COPY_CHUNK (1UL << 30)
+
+/* size of the pipe used by splice, if the kernel allows it */
+#define COPY_PIPE (1UL << 20)
+
+/* copy errors a method can't do, rather than failures */
+#define COPY_UNSUPPORTED(e) ((e) == ENOSYS || (e) == EXDEV || (e) == EOPNOTSUPP || (e) == EINVAL)
+
+static int copy_read_write(int in, int out, size_t len, char *buf, size_t bufsize){
+
+  size_t done = 0;
+  ssize_t n;
+
+  while(done < len){
+    n = read(in, buf, bufsize);
+    if(n <= 0) return -1;
+    if(write(out, buf, n) != n) return -1;
+    done += n;
+  }
+
+  return 0;
+
+}
+
+static int copy_kernel(int in, int out, size_t len, int method){
+
+  size_t left = len;
+  ssize_t n, m, k;
+  int p[2];
+
+#ifdef __linux__
+  if(method == COPY_SPLICE){
+    if(pipe(p) != 0) return -1;
+#ifdef F_SETPIPE_SZ
+    fcntl(p[1], F_SETPIPE_SZ, COPY_PIPE);
+#endif
+  }
+#endif
+
+  while(left > 0){
+    n = -1;
+    errno = ENOSYS;
+
+#ifdef __linux__
+    switch(method){
+#ifdef SYS_copy_file_range
+    case COPY_FILE_RANGE:
+      n = syscall(SYS_copy_file_range, in, NULL, out, NULL, left < COPY_CHUNK ? left : COPY_CHUNK, 0);
+      break;
+#endif
+    case COPY_SENDFILE:
+      n = sendfile(out, in, NULL, left < COPY_CHUNK ? left : COPY_CHUNK);
+      break;
+    case COPY_SPLICE:
+      n = splice(in, NULL, p[1], NULL, left < COPY_PIPE ? left : COPY_PIPE, SPLICE_F_MOVE);
+      /* drain the pipe into the destination */
+      for(m=0; n>0 && m<n; m+=k){
+        k = splice(p[0], NULL, out, NULL, n - m, SPLICE_F_MOVE);
+        if(k <= 0){
+          n = -1;
+          break;
+        }
+      }
+      break;
+    }
+#endif
+
+    if(n <= 0){
+      if(n == 0) errno = EIO;
+      break;
+    }
+    left -= n;
+  }
+
+#ifdef __linux__
+  if(method == COPY_SPLICE){
+    close(p[0]);
+    close(p[1]);
+  }
+#endif
+
+  if(left == 0) return 0;
+  return COPY_UNSUPPORTED(errno) && left == len ? -2 : -1;
+
+}
+
+/*
+ * Copy the len byte file from to the file to with a method, and with a
+ * buffer of bufsize bytes for read_write. The source is dropped from the
+ * page cache first and the copy is synced before it counts as done. The
+ * elapsed time is returned in seconds and the CPU time used by the process
+ * in user and sys, or a negative value if the method is not supported
+ * (-2) or on error (-1).
+ */
+static double copy_pass(char *from, char *to, size_t len, int method, char *buf, size_t bufsize,
+                        double *user, double *sys){
+
+  struct timespec start, end;
+  struct rusage r1, r2;
+  int in, out, err;
+
+  in = open(from, O_RDONLY);
+  out = open(to, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+  if(in < 0 || out < 0){
+    fprintf(stderr, "ERROR: unable to open %s or %s in copy_pass\n", from, to);
+    return -1.0;
+  }
+#ifdef POSIX_FADV_DONTNEED
+  posix_fadvise(in, 0, len, POSIX_FADV_DONTNEED);
+#endif
+
+  getrusage(RUSAGE_SELF, &r1);
+  clock_gettime(CLOCK, &start);
+
+  if(method == COPY_READ_WRITE) err = copy_read_write(in, out, len, buf, bufsize);
+  else err = copy_kernel(in, out, len, method);
+  if(err == 0) fsync(out);
+
+  clock_gettime(CLOCK, &end);
+  getrusage(RUSAGE_SELF, &r2);
+
+  close(in);
+  close(out);
+  unlink(to);
+
+  if(err != 0) return err == -2 ? -2.0 : -1.0;
+
+  *user = (r2.ru_utime.tv_sec - r1.ru_utime.tv_sec) + 1e-6 * (r2.ru_utime.tv_usec - r1.ru_utime.tv_usec);
+  *sys = (r2.ru_stime.tv_sec - r1.ru_stime.tv_sec) + 1e-6 * (r2.ru_stime.tv_usec - r1.ru_stime.tv_usec);
+
+  return time_diff(&start, &end);
+
+}
+
+/*
+ * Copy an N MB file with each method, into the same directory and, if
+ * other is given, into that directory too (typically on another
+ * filesystem), and print the bandwidth and CPU time of each copy.
+ */
+int file_copy(unsigned int N, char *other){
+
+  char *from = "testfile_1";
+  char to[600];
+  char *dirs[2] = {".", other};
+  size_t len = (size_t)N << 20;
+  struct stat here, there;
+  double duration, user, sys;
+  char *buf;
+  int d, method, b, fd;
+  unsigned long i;
+
+  buf = malloc(copy_buffers[COPY_BUFFERS-1]);
+  if(!buf){
+    fprintf(stderr, "ERROR: out of memory in file_copy\n");
+    return 1;
+  }
+  memset(buf, 0x5a, copy_buffers[COPY_BUFFERS-1]);
+
+  /* create the source file */
+  fd = open(from, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+  if(fd < 0){
+    fprintf(stderr, "ERROR: unable to open test file for writing in file_copy\n");
+    return 1;
+  }
+  for(i=0; i<N; i++){
+    write(fd, buf, 1UL << 20);
+  }
+  fsync(fd);
+  close(fd);
+  stat(".", &here);
+
+  for(d=0; d<2 && dirs[d]; d++){
+    if(stat(dirs[d], &there) != 0){
+      fprintf(stderr, "ERROR: unable to use %s as the copy destination in file_copy\n", dirs[d]);
+      break;
+    }
+    sprintf(to, "%s/testfile_copy", dirs[d]);
+
+    printf("\n--- file_copy: %u MB to %s (%s filesystem)\n", N, dirs[d],
+           here.st_dev == there.st_dev ? "same" : "different");
+    printf("--- Timings ------------------------------------------------------------------------\n");
+    printf("|\n");
+    printf("| %-16s %8s %12s %10s %10s %10s %8s\n", "Method", "Buffer", "Time (s)", "GB/s", "User (s)", "Sys (s)", "CPU %");
+
+    for(method=0; method<NUM_COPY; method++){
+      for(b=0; b<(method == COPY_READ_WRITE ? COPY_BUFFERS : 1); b++){
+        duration = copy_pass(from, to, len, method, buf, copy_buffers[b], &user, &sys);
+        if(duration == -2.0){
+          printf("| %-16s %8s %12s\n", copy_names[method], "-", "not supported");
+          continue;
+        }
+        if(duration < 0){
+          fprintf(stderr, "ERROR: %s to %s failed in file_copy: %s\n", copy_names[method], to, strerror(errno));
+          continue;
+        }
+
+        if(method == COPY_READ_WRITE) printf("| %-16s %7zuK", copy_names[method], copy_buffers[b] >> 10);
+        else printf("| %-16s %8s", copy_names[method], "-");
+        printf(" %12.6f %10.3f %10.6f %10.6f %8.1f\n", duration, len / duration / 1e9, user, sys,
+               100 * (user + sys) / duration);
+      }
+    }
+
+    printf("|\n");
+    printf("------------------------------------------------------------------------------------\n");
+  }
+
+  unlink(from);
+  free(buf);
+  fflush(stdout);
+
+  return 0;
+}
@@ -0,0 +1,228 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+#ifndef __MACH__
+
+/* need this to get O_DIRECT definition */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "utils.h"
+#include "latency.h"
+
+/* block sizes and buffer alignments swept, as powers of two */
+#define SWEEP_MIN_BLOCK 9
+#define SWEEP_MAX_BLOCK 26
+#define SWEEP_MIN_ALIGN 9
+#define SWEEP_MAX_ALIGN 21
+#define SWEEP_BLOCKS (SWEEP_MAX_BLOCK - SWEEP_MIN_BLOCK + 1)
+#define SWEEP_ALIGNS (SWEEP_MAX_ALIGN - SWEEP_MIN_ALIGN + 1)
+
+/* each measurement moves about this many bytes, in 4 to 4096 requests */
+#define SWEEP_BYTES (64UL << 20)
+#define SWEEP_MIN_OPS 4
+#define SWEEP_MAX_OPS 4096
+
+/* a bandwidth within this fraction of the peak counts as saturating */
+#define SWEEP_SATURATED 0.9
+
+static void sweep_size(char *s, size_t bytes){
+
+  if(bytes >= (1UL << 20)) sprintf(s, "%zuM", bytes >> 20);
+  else if(bytes >= (1UL << 10)) sprintf(s, "%zuK", bytes >> 10);
+  else sprintf(s, "%zu", bytes);
+
+}
+
+/*
+ * Time ops O_DIRECT reads or writes of bs bytes at the offsets given,
+ * to or from buf. Returns the duration in seconds, or a negative value if
+ * the device refused the transfer (typically EINVAL for an alignment it
+ * cannot do).
+ */
+static double sweep_pass(int fd, char *buf, size_t bs, off_t *offsets, unsigned long ops, int writing){
+
+  struct timespec start, end;
+  unsigned long i;
+  ssize_t done;
+
+  clock_gettime(CLOCK, &start);
+
+  for(i=0; i<ops; i++){
+    if(writing) done = pwrite(fd, buf, bs, offsets[i]);
+    else done = pread(fd, buf, bs, offsets[i]);
+    if(done != (ssize_t)bs) return -1.0;
+  }
+
+  clock_gettime(CLOCK, &end);
+
+  return time_diff(&start, &end);
+
+}
+
+/*
+ * Read or write an N MB file with O_DIRECT for every block size from 512
+ * bytes to 64 MB and every buffer alignment from 512 bytes to 2 MB,
+ * sequentially and at random block offsets. A buffer of alignment A is
+ * aligned to A but not to 2A. Prints the bandwidth for each pair, the
+ * IOPS at each block size's best alignment, and the smallest block size
+ * that gets within 90% of the peak bandwidth.
+ */
+int file_direct_sweep(unsigned int N, int writing){
+
+  char *op = writing ? "file_write_direct_sweep" : "file_read_direct_sweep";
+  char *name = "testfile_1";
+  char label[20];
+  size_t len = (size_t)N << 20;
+  size_t bs, align, saturating;
+  unsigned long blocks, ops, i;
+  double duration, best, peak, rate[SWEEP_BLOCKS][SWEEP_ALIGNS], iops[SWEEP_BLOCKS];
+  off_t *offsets;
+  char *base, *buf;
+  int b, a, fd, random_order;
+
+  if(len < (1UL << SWEEP_MIN_BLOCK)){
+    fprintf(stderr, "ERROR: %s needs a file size of at least 1 MB\n", op);
+    return 1;
+  }
+
+  /* room to place a 64 MB buffer at any alignment up to 2 MB */
+  if(posix_memalign((void **)&base, 2UL << SWEEP_MAX_ALIGN, (1UL << SWEEP_MAX_BLOCK) + (2UL << SWEEP_MAX_ALIGN)) != 0){
+    fprintf(stderr, "ERROR: out of memory in %s\n", op);
+    return 1;
+  }
+  offsets = malloc(SWEEP_MAX_OPS * sizeof(off_t));
+  if(!offsets){
+    fprintf(stderr, "ERROR: out of memory in %s\n", op);
+    return 1;
+  }
+  memset(base, 0x5a, (1UL << SWEEP_MAX_BLOCK) + (2UL << SWEEP_MAX_ALIGN));
+
+  /* create the test file and drop it from the page cache */
+  fd = open(name, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+  if(fd < 0){
+    fprintf(stderr, "ERROR: unable to open test file for writing in %s\n", op);
+    return 1;
+  }
+  for(i=0; i<len; i+=(1UL << 20)){
+    write(fd, base, 1UL << 20);
+  }
+  fsync(fd);
+#ifdef POSIX_FADV_DONTNEED
+  posix_fadvise(fd, 0, len, POSIX_FADV_DONTNEED);
+#endif
+  close(fd);
+
+  fd = open(name, (writing ? O_WRONLY : O_RDONLY) | O_DIRECT);
+  if(fd < 0){
+    fprintf(stderr, "ERROR: unable to open test file with O_DIRECT in %s: %s\n", op, strerror(errno));
+    unlink(name);
+    return 1;
+  }
+
+  for(random_order=0; random_order<2; random_order++){
+    peak = 0.0;
+
+    for(b=0; b<SWEEP_BLOCKS; b++){
+      bs = 1UL << (SWEEP_MIN_BLOCK + b);
+      iops[b] = 0.0;
+      if(bs > len) continue;
+
+      blocks = len / bs;
+      ops = SWEEP_BYTES / bs;
+      if(ops < SWEEP_MIN_OPS) ops = SWEEP_MIN_OPS;
+      if(ops > SWEEP_MAX_OPS) ops = SWEEP_MAX_OPS;
+
+      for(i=0; i<ops; i++){
+        offsets[i] = (off_t)(random_order ? rand() % blocks : i % blocks) * bs;
+      }
+
+      for(a=0; a<SWEEP_ALIGNS; a++){
+        align = 1UL << (SWEEP_MIN_ALIGN + a);
+        buf = base + align;
+
+        duration = sweep_pass(fd, buf, bs, offsets, ops, writing);
+        if(duration <= 0){
+          rate[b][a] = -1.0;
+          continue;
+        }
+        rate[b][a] = (double)ops * bs / duration / 1e6;
+        if(rate[b][a] > peak) peak = rate[b][a];
+        if((double)ops / duration > iops[b]) iops[b] = (double)ops / duration;
+      }
+    }
+
+    printf("\n--- %s: %u MB file, %s, MB/s by block size and buffer alignment\n", op, N,
+           random_order ? "random" : "sequential");
+    printf("--- Timings ------------------------------------------------------------------------\n");
+    printf("|\n");
+    printf("| %6s %10s", "Block", "Best IOPS");
+    for(a=0; a<SWEEP_ALIGNS; a++){
+      sweep_size(label, 1UL << (SWEEP_MIN_ALIGN + a));
+      printf(" %8s", label);
+    }
+    printf("\n");
+
+    saturating = 0;
+    for(b=0; b<SWEEP_BLOCKS; b++){
+      bs = 1UL << (SWEEP_MIN_BLOCK + b);
+      if(bs > len) continue;
+
+      sweep_size(label, bs);
+      printf("| %6s %10.0f", label, iops[b]);
+      best = 0.0;
+      for(a=0; a<SWEEP_ALIGNS; a++){
+        if(rate[b][a] < 0) printf(" %8s", "-");
+        else printf(" %8.1f", rate[b][a]);
+        if(rate[b][a] > best) best = rate[b][a];
+      }
+      printf("\n");
+      if(!saturating && peak > 0 && best >= SWEEP_SATURATED * peak) saturating = bs;
+    }
+
+    printf("|\n");
+    if(saturating){
+      sweep_size(label, saturating);
+      printf("| Peak %.1f MB/s, %s byte blocks reach %.0f%% of it. \"-\" marks a transfer the device refused.\n",
+             peak, label, 100 * SWEEP_SATURATED);
+    }
+    else printf("| Every transfer was refused.\n");
+    printf("------------------------------------------------------------------------------------\n");
+  }
+
+  close(fd);
+  unlink(name);
+  free(offsets);
+  free(base);
+  fflush(stdout);
+
+  return 0;
+}
+
+#endif
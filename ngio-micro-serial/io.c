@@ -38,13 +38,67 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <time.h>
+#include <sys/uio.h>
 
 #include "utils.h"
+#include "level0.h"
+#include "latency.h"
 
 #ifdef PMEM
 #include<libpmem.h>
 #endif
 
+/* operations timed one by one when io_histograms is set */
+#define IO_OPEN 0
+#define IO_WRITE 1
+#define IO_FSYNC 2
+#define IO_READ 3
+#define IO_CLOSE 4
+#define NUM_IO_OPS 5
+
+static char *io_op_names[NUM_IO_OPS] = {"open", "write", "fsync", "read", "close"};
+static struct histogram io_hist[NUM_IO_OPS];
+
+#define TIMED(op, call) do {						\
+	struct timespec op_start, op_end;				\
+	if (io_histograms) {						\
+	    clock_gettime(CLOCK, &op_start);				\
+	    call;							\
+	    clock_gettime(CLOCK, &op_end);				\
+	    hist_record(&io_hist[op], time_diff(&op_start, &op_end));	\
+	}								\
+	else call;							\
+    } while (0)
+
+static void io_hist_reset(void)
+{
+    int op;
+
+    for (op = 0; op < NUM_IO_OPS; op++)
+	hist_reset(&io_hist[op], io_op_names[op]);
+}
+
+/*
+ * Print the latency table of the operations timed since io_hist_reset,
+ * with the number of each done per second of the duration seconds the
+ * run took, and the throughput of the bytes it moved.
+ */
+static void io_latencies(char *title, double duration, double bytes)
+{
+    int op;
+
+    if (!io_histograms) return;
+
+    latency_header(title);
+    for (op = 0; op < NUM_IO_OPS; op++) {
+	if (io_hist[op].n > 0)
+	    latency_row(io_op_names[op], &io_hist[op], io_hist[op].n / duration);
+    }
+    printf("|\n");
+    printf("| Throughput: %.3f MB/s\n", bytes / duration / 1e6);
+    latency_footer();
+}
+
 
 int mk_rm_dir(unsigned int N){
 
@@ -166,6 +220,7 @@ int file_write(unsigned int N)
 	sprintf(titlebuffer, "file_write: %d files of %d bytes", N, size);
 
 	/* do actual write test */
+	io_hist_reset();
 	clock_gettime(CLOCK, &start);
 
 	reps = 128 / N;
@@ -175,19 +230,19 @@ int file_write(unsigned int N)
 	    for (i = 0; i < N; i++) {
 		sprintf(name, "testfile_%d", i);
 		
-		fd = open(name, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+		TIMED(IO_OPEN, fd = open(name, O_CREAT|O_WRONLY|O_TRUNC, 0644));
 		if (fd < 0) {
 		    fprintf(stderr, "ERROR: unable to open test file for writing in file_write\n");
 		    return 1;
 		}
-		write(fd, data, size);
-		fsync(fd);
-		close(fd);
+		TIMED(IO_WRITE, write(fd, data, size));
+		TIMED(IO_FSYNC, fsync(fd));
+		TIMED(IO_CLOSE, close(fd));
 	    }
 	}
 
 	clock_gettime(CLOCK, &end);
-	elapsed_time_hr(start, end, titlebuffer);
+	io_latencies(titlebuffer, elapsed_time_hr(start, end, titlebuffer), (double)reps * N * size);
 
 	/* remove files just created */
 	for (i = 0; i < N; i++) {
@@ -383,6 +438,7 @@ int file_write_random(unsigned int N)
 
 	sprintf(titlebuffer, "file_write_random: %d blocks of %d bytes", N, size);
 
+	io_hist_reset();
 	clock_gettime(CLOCK, &start);
 
 	reps = 128 / N;
@@ -391,7 +447,7 @@ int file_write_random(unsigned int N)
 	for (j = 0; j < reps; j++) {
 	    for (i = 0; i < N; i++) {
 		/* open the big test file for writing */
-		fd = open("testfile_1", O_WRONLY);
+		TIMED(IO_OPEN, fd = open("testfile_1", O_WRONLY));
 		if (fd < 0) {
 		    fprintf(stderr, "ERROR: unable to open test file for writing in file_write_random\n");
 		    return 1;
@@ -402,14 +458,14 @@ int file_write_random(unsigned int N)
 		
 		/* write to that block */
 		lseek(fd, block * size, SEEK_SET);
-		write(fd, data, size);
-		fsync(fd);
-		close(fd);
+		TIMED(IO_WRITE, write(fd, data, size));
+		TIMED(IO_FSYNC, fsync(fd));
+		TIMED(IO_CLOSE, close(fd));
 	    }
 	}
 
 	clock_gettime(CLOCK, &end);
-	elapsed_time_hr(start, end, titlebuffer);
+	io_latencies(titlebuffer, elapsed_time_hr(start, end, titlebuffer), (double)reps * N * size);
 
 	/* halve number of blocks but double their size */
 	N = N / 2;
@@ -587,24 +643,25 @@ int file_read(unsigned int N)
 	if (reps == 0) reps = 1;
 
 	/* now do read test */
+	io_hist_reset();
 	clock_gettime(CLOCK, &start);
 	
 	for (j = 0; j < reps; j++) {
 	    for (i = 0; i < N; i++) {
 		sprintf(name, "testfile_%d", i);
 		
-		fd = open(name, O_RDONLY);
+		TIMED(IO_OPEN, fd = open(name, O_RDONLY));
 		if (fd < 0) {
 		    fprintf(stderr, "ERROR: unable to open test file for reading in file_read\n");
 		    return 1;
 		}
-		read(fd, data, size);
-		close(fd);
+		TIMED(IO_READ, read(fd, data, size));
+		TIMED(IO_CLOSE, close(fd));
 	    }
 	}
 
 	clock_gettime(CLOCK, &end);
-	elapsed_time_hr(start, end, titlebuffer);
+	io_latencies(titlebuffer, elapsed_time_hr(start, end, titlebuffer), (double)reps * N * size);
 
 	/* remove files just created */
 	for (i = 0; i < N; i++) {
@@ -789,24 +846,25 @@ int file_read_direct(unsigned int N)
 	if (reps == 0) reps = 1;
 
 	/* now do read test */
+	io_hist_reset();
 	clock_gettime(CLOCK, &start);
 
 	for (j = 0; j < reps; j++) {
 	    for (i = 0; i < N; i++) {
 		sprintf(name, "testfile_%d", i);
 		
-		fd = open(name, O_RDONLY|O_DIRECT);
+		TIMED(IO_OPEN, fd = open(name, O_RDONLY|O_DIRECT));
 		if (fd < 0) {
 		    fprintf(stderr, "ERROR: unable to open test file for reading in file_read_direct\n");
 		    return 1;
 		}
-		read(fd, data, size);
-		close(fd);
+		TIMED(IO_READ, read(fd, data, size));
+		TIMED(IO_CLOSE, close(fd));
 	    }
 	}
 
 	clock_gettime(CLOCK, &end);
-	elapsed_time_hr(start, end, titlebuffer);
+	io_latencies(titlebuffer, elapsed_time_hr(start, end, titlebuffer), (double)reps * N * size);
 
 	/* remove files just created */
 	for (i = 0; i < N; i++) {
@@ -875,12 +933,13 @@ int file_read_random(unsigned int N)
 	reps = 65536 / N;
 	if (reps == 0) reps = 1;
 
+	io_hist_reset();
 	clock_gettime(CLOCK, &start);
 
 	for (j = 0; j < reps; j++) {
 	    for (i = 0; i < N; i++) {
 		/* open the big test file for reading */
-		fd = open("testfile_1", O_RDONLY);
+		TIMED(IO_OPEN, fd = open("testfile_1", O_RDONLY));
 		if (fd < 0) {
 		    fprintf(stderr, "ERROR: unable to open test file for reading in file_read_random\n");
 		    return 1;
@@ -891,13 +950,13 @@ int file_read_random(unsigned int N)
 		
 		/* write to that block */
 		lseek(fd, block * size, SEEK_SET);
-		read(fd, data, size);
-		close(fd);
+		TIMED(IO_READ, read(fd, data, size));
+		TIMED(IO_CLOSE, close(fd));
 	    }
 	}
 
 	clock_gettime(CLOCK, &end);
-	elapsed_time_hr(start, end, titlebuffer);
+	io_latencies(titlebuffer, elapsed_time_hr(start, end, titlebuffer), (double)reps * N * size);
 
 	/* halve number of blocks but double their size */
 	N = N / 2;
@@ -1074,12 +1133,13 @@ int file_read_random_direct(unsigned int N)
 	reps = 512 / N;
 	if (reps == 0) reps = 1;
 
+	io_hist_reset();
 	clock_gettime(CLOCK, &start);
 
 	for (j = 0; j < reps; j++) {
 	    for (i = 0; i < N; i++) {
 		/* open the big test file for reading */
-		fd = open("testfile_1", O_RDONLY|O_DIRECT);
+		TIMED(IO_OPEN, fd = open("testfile_1", O_RDONLY|O_DIRECT));
 		if (fd < 0) {
 		    fprintf(stderr, "ERROR: unable to open test file for reading in file_read_random_direct\n");
 		    return 1;
@@ -1090,13 +1150,13 @@ int file_read_random_direct(unsigned int N)
 		
 		/* write to that block */
 		lseek(fd, block * size, SEEK_SET);
-		read(fd, data, size);
-		close(fd);
+		TIMED(IO_READ, read(fd, data, size));
+		TIMED(IO_CLOSE, close(fd));
 	    }
 	}
 
 	clock_gettime(CLOCK, &end);
-	elapsed_time_hr(start, end, titlebuffer);
+	io_latencies(titlebuffer, elapsed_time_hr(start, end, titlebuffer), (double)reps * N * size);
 
 	/* halve number of blocks but double their size */
 	N = N / 2;
@@ -1111,3 +1171,168 @@ int file_read_random_direct(unsigned int N)
     return 0;
 }
 #endif
+
+
+/* one random-block pass of file_random_compare, returns the time per block */
+static double random_pass(int variant, int fd, unsigned char *data, struct iovec *iov,
+			  int N, int size, int K, int reps, int writing)
+{
+    struct timespec start, end;
+    int i, j, k, block, batch;
+    long done = 0;
+
+    clock_gettime(CLOCK, &start);
+
+    for (j = 0; j < reps; j++) {
+	for (i = 0; i < N; i += batch) {
+	    batch = 1;
+
+	    switch (variant) {
+	    case 0:
+		/* reopen the file for every block, as file_write_random does */
+		fd = open("testfile_1", writing ? O_WRONLY : O_RDONLY);
+		if (fd < 0) {
+		    fprintf(stderr, "ERROR: unable to open test file in file_random_compare\n");
+		    return -1.0;
+		}
+		block = rand() % N;
+		lseek(fd, (off_t)block * size, SEEK_SET);
+		if (writing) {
+		    write(fd, data, size);
+		    fsync(fd);
+		}
+		else read(fd, data, size);
+		close(fd);
+		break;
+
+	    case 1:
+		block = rand() % N;
+		if (writing) {
+		    pwrite(fd, data, size, (off_t)block * size);
+		    fsync(fd);
+		}
+		else pread(fd, data, size, (off_t)block * size);
+		break;
+
+	    case 2:
+		/* K blocks starting at a random block, each into its own buffer */
+		batch = K < N - i ? K : N - i;
+		block = rand() % (N - batch + 1);
+		for (k = 0; k < batch; k++) {
+		    iov[k].iov_base = data + (size_t)k * size;
+		    iov[k].iov_len = size;
+		}
+		if (writing) {
+		    pwritev(fd, iov, batch, (off_t)block * size);
+		    fsync(fd);
+		}
+		else preadv(fd, iov, batch, (off_t)block * size);
+		break;
+	    }
+	    done += batch;
+	}
+    }
+
+    clock_gettime(CLOCK, &end);
+
+    return ((end.tv_sec - start.tv_sec) + ((double)(end.tv_nsec - start.tv_nsec)/1000000000)) / done;
+}
+
+/*
+ * Random block reads or writes done three ways: reopening the file for
+ * every block (as file_read_random and file_write_random do), keeping it
+ * open and using pread/pwrite, and keeping it open and using
+ * preadv/pwritev to move K blocks per call. preadv/pwritev take one file
+ * offset, so a batch is K adjacent blocks starting at a random block.
+ * Writes are followed by an fsync per call in every case.
+ */
+int file_random_compare(unsigned int N, unsigned int K, int writing)
+{
+    char titlebuffer[500];
+    int size = 1;
+    unsigned char *data;
+    struct iovec *iov;
+    double per_block[3];
+    int fd, v;
+    int reps;
+    size_t buffer_size;
+    char *op = writing ? "file_write_random_compare" : "file_read_random_compare";
+
+    if (K == 0) K = 1;
+
+    /* room for a full batch of the largest blocks */
+    buffer_size = (size_t)N * K;
+    data = malloc(buffer_size);
+    iov = malloc(K * sizeof(struct iovec));
+    if (!data || !iov) {
+	fprintf(stderr, "ERROR: out of memory in %s\n", op);
+	return 1;
+    }
+    fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0) {
+	fprintf(stderr, "ERROR: unable to open /dev/urandom in %s\n", op);
+	return 1;
+    }
+    read(fd, data, N);
+    close(fd);
+
+    /* now create the test file */
+    fd = open("testfile_1", O_CREAT|O_WRONLY|O_TRUNC, 0644);
+    if (fd < 0) {
+	fprintf(stderr, "ERROR: unable to open test file for writing in %s\n", op);
+	return 1;
+    }
+    write(fd, data, N);
+    fsync(fd);
+    close(fd);
+
+    /* don't overload the system by doing too many tiny blocks */
+    while (N >= 10000) {
+	N = N / 2;
+	size = size * 2;
+    }
+
+    sprintf(titlebuffer, "%s: time per block, batches of %u for %s", op, K,
+	    writing ? "pwritev" : "preadv");
+    printf("\n--- %s\n", titlebuffer);
+    printf("--- Timings (us) -------------------------------------------------------------------\n");
+    printf("|\n");
+    printf("| %10s %10s %16s %16s %16s\n", "Blocks", "Bytes", "open per block",
+	   writing ? "pwrite" : "pread", writing ? "pwritev" : "preadv");
+
+    fd = open("testfile_1", writing ? O_WRONLY : O_RDONLY);
+    if (fd < 0) {
+	fprintf(stderr, "ERROR: unable to open test file in %s\n", op);
+	return 1;
+    }
+
+    while (N >= 1) {
+
+	reps = (writing ? 128 : 65536) / N;
+	if (reps == 0) reps = 1;
+
+	for (v = 0; v < 3; v++) {
+	    per_block[v] = random_pass(v, fd, data, iov, N, size, K, reps, writing);
+	    if (per_block[v] < 0) return 1;
+	}
+
+	printf("| %10d %10d %16.3f %16.3f %16.3f\n", N, size,
+	       1e6*per_block[0], 1e6*per_block[1], 1e6*per_block[2]);
+
+	/* halve number of blocks but double their size */
+	N = N / 2;
+	size = size * 2;
+    }
+
+    printf("|\n");
+    printf("------------------------------------------------------------------------------------\n");
+
+    /* clean up the test file */
+    close(fd);
+    unlink("testfile_1");
+    free(iov);
+    free(data);
+    fflush(stdout);
+
+    return 0;
+}
@@ -0,0 +1,812 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+/* need this to get O_DIRECT definition */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "latency.h"
+#include "aio.h"
+
+#ifdef PMEM
+#include<libpmem.h>
+#endif
+
+/*
+ * Job-file driven I/O workloads. A job file is a list of sections, each
+ * one job, with key=value lines:
+ *
+ *   [checkpoint]
+ *   engine=posix        posix, mmap or pmem
+ *   rw=write            read, write or mix
+ *   rwmix_read=70       percentage of reads when rw=mix
+ *   pattern=sequential  sequential or random
+ *   bs=1M               block size
+ *   size=1G             size of each file
+ *   files=4             number of files
+ *   direct=1            open with O_DIRECT (posix engine)
+ *   sync=end            none, end, always or N (sync every N writes)
+ *   fdatasync=1         use fdatasync rather than fsync (posix engine)
+ *   threads=4           number of threads
+ *   qd=16               requests in flight per thread (posix engine)
+ *   ops=100000          total number of blocks moved, 0 covers the files once
+ *   directory=/mnt/nvme where the files are created
+ *
+ * A [global] section sets defaults for the jobs after it. Sizes take k, m
+ * and g suffixes (powers of 1024). # and ; start comments.
+ */
+
+#define ENGINE_POSIX 0
+#define ENGINE_MMAP 1
+#define ENGINE_PMEM 2
+
+#define RW_READ 0
+#define RW_WRITE 1
+#define RW_MIX 2
+
+#define PATTERN_SEQUENTIAL 0
+#define PATTERN_RANDOM 1
+
+/* sync policies other than every N writes */
+#define SYNC_NONE 0
+#define SYNC_END -1
+
+#define JOB_READ 0
+#define JOB_WRITE 1
+#define JOB_SYNC 2
+#define NUM_JOB_OPS 3
+
+#define MAX_JOBS 64
+
+static char *engine_names[] = {"posix", "mmap", "pmem"};
+static char *rw_names[] = {"read", "write", "mix"};
+static char *pattern_names[] = {"sequential", "random"};
+static char *job_op_names[NUM_JOB_OPS] = {"read", "write", "sync"};
+
+struct job {
+  char name[64];
+  int engine;
+  int rw;
+  int rwmix_read;
+  int pattern;
+  unsigned long bs;
+  unsigned long long size;
+  unsigned int files;
+  int direct;
+  int sync;
+  int fdatasync;
+  unsigned int threads;
+  unsigned int qd;
+  unsigned long long ops;
+  char directory[256];
+};
+
+struct job_file {
+  char name[512];
+  int fd;
+  char *addr;
+  size_t len;
+  int is_pmem;
+};
+
+struct job_thread {
+  pthread_t thread;
+  int id;
+  struct job *job;
+  struct job_file *files;
+  unsigned long long per_file;
+  unsigned long long ops;
+  unsigned long long first, blocks;
+  unsigned long long x;
+  unsigned long writes;
+  struct histogram hist[NUM_JOB_OPS];
+  int errors;
+};
+
+static void job_defaults(struct job *j){
+
+  memset(j, 0, sizeof(struct job));
+  strcpy(j->name, "global");
+  j->engine = ENGINE_POSIX;
+  j->rw = RW_READ;
+  j->rwmix_read = 50;
+  j->pattern = PATTERN_SEQUENTIAL;
+  j->bs = 4096;
+  j->size = 64ULL << 20;
+  j->files = 1;
+  j->sync = SYNC_NONE;
+  j->threads = 1;
+  j->qd = 1;
+  strcpy(j->directory, ".");
+
+}
+
+static unsigned long long parse_size(char *value){
+
+  char *end;
+  unsigned long long n = strtoull(value, &end, 10);
+
+  switch(tolower(*end)){
+  case 'g':
+    n <<= 10;
+    /* fall through */
+  case 'm':
+    n <<= 10;
+    /* fall through */
+  case 'k':
+    n <<= 10;
+  }
+
+  return n;
+
+}
+
+static int lookup(char *value, char **names, int n){
+
+  int i;
+
+  for(i=0; i<n; i++){
+    if(strcmp(value, names[i]) == 0) return i;
+  }
+
+  return -1;
+
+}
+
+/* Set one key of a job, returns 0 if the key or value is not valid. */
+static int job_set(struct job *j, char *key, char *value){
+
+  if(strcmp(key, "engine") == 0) return (j->engine = lookup(value, engine_names, 3)) >= 0;
+  if(strcmp(key, "rw") == 0) return (j->rw = lookup(value, rw_names, 3)) >= 0;
+  if(strcmp(key, "pattern") == 0) return (j->pattern = lookup(value, pattern_names, 2)) >= 0;
+
+  if(strcmp(key, "rwmix_read") == 0){
+    j->rwmix_read = atoi(value);
+    return j->rwmix_read >= 0 && j->rwmix_read <= 100;
+  }
+  if(strcmp(key, "bs") == 0) return (j->bs = parse_size(value)) > 0;
+  if(strcmp(key, "size") == 0) return (j->size = parse_size(value)) > 0;
+  if(strcmp(key, "files") == 0) return (j->files = atoi(value)) > 0;
+  if(strcmp(key, "direct") == 0){
+    j->direct = atoi(value);
+    return 1;
+  }
+  if(strcmp(key, "sync") == 0){
+    if(strcmp(value, "none") == 0) j->sync = SYNC_NONE;
+    else if(strcmp(value, "end") == 0) j->sync = SYNC_END;
+    else if(strcmp(value, "always") == 0) j->sync = 1;
+    else if((j->sync = atoi(value)) <= 0) return 0;
+    return 1;
+  }
+  if(strcmp(key, "fdatasync") == 0){
+    j->fdatasync = atoi(value);
+    return 1;
+  }
+  if(strcmp(key, "threads") == 0) return (j->threads = atoi(value)) > 0;
+  if(strcmp(key, "qd") == 0){
+    j->qd = atoi(value);
+    return j->qd > 0 && j->qd <= AIO_MAX_QD;
+  }
+  if(strcmp(key, "ops") == 0){
+    j->ops = parse_size(value);
+    return 1;
+  }
+  if(strcmp(key, "directory") == 0){
+    strncpy(j->directory, value, sizeof(j->directory) - 1);
+    return 1;
+  }
+
+  return 0;
+
+}
+
+static char *trim(char *s){
+
+  char *end;
+
+  while(isspace((unsigned char)*s)) s++;
+  end = s + strlen(s);
+  while(end > s && isspace((unsigned char)end[-1])) end--;
+  *end = '\0';
+
+  return s;
+
+}
+
+/* Read the jobs in path, returns the number of jobs or -1 on error. */
+static int parse_jobs(char *path, struct job *jobs){
+
+  FILE *f;
+  char buffer[1024];
+  char *line, *eq;
+  struct job global;
+  struct job *current = &global;
+  int n = 0, lineno = 0;
+
+  f = fopen(path, "r");
+  if(!f){
+    fprintf(stderr, "ERROR: unable to open job file %s\n", path);
+    return -1;
+  }
+
+  job_defaults(&global);
+
+  while(fgets(buffer, sizeof(buffer), f)){
+    lineno++;
+    buffer[strcspn(buffer, "#;\n")] = '\0';
+    line = trim(buffer);
+    if(*line == '\0') continue;
+
+    if(*line == '['){
+      line[strcspn(line, "]")] = '\0';
+      line = trim(line + 1);
+      if(strcmp(line, "global") == 0){
+        current = &global;
+        continue;
+      }
+      if(n == MAX_JOBS){
+        fprintf(stderr, "ERROR: more than %d jobs in %s\n", MAX_JOBS, path);
+        fclose(f);
+        return -1;
+      }
+      current = &jobs[n++];
+      *current = global;
+      strncpy(current->name, line, sizeof(current->name) - 1);
+      continue;
+    }
+
+    eq = strchr(line, '=');
+    if(!eq){
+      fprintf(stderr, "ERROR: expected key=value at %s line %d\n", path, lineno);
+      fclose(f);
+      return -1;
+    }
+    *eq = '\0';
+    if(!job_set(current, trim(line), trim(eq + 1))){
+      fprintf(stderr, "ERROR: invalid setting %s at %s line %d\n", trim(line), path, lineno);
+      fclose(f);
+      return -1;
+    }
+  }
+
+  fclose(f);
+  return n;
+
+}
+
+static unsigned long long next_random(unsigned long long *x){
+
+  /* xorshift64 */
+  *x ^= *x << 13;
+  *x ^= *x >> 7;
+  *x ^= *x << 17;
+  return *x;
+
+}
+
+/* the i-th block a thread works on, counting the files end to end */
+static unsigned long long next_block(struct job_thread *t, unsigned long long i){
+
+  if(t->job->pattern == PATTERN_RANDOM)
+    return next_random(&t->x) % (t->per_file * t->job->files);
+
+  return t->first + i % t->blocks;
+
+}
+
+static int next_is_read(struct job_thread *t){
+
+  if(t->job->rw == RW_MIX) return (int)(next_random(&t->x) % 100) < t->job->rwmix_read;
+
+  return t->job->rw == RW_READ;
+
+}
+
+/* Move one block between buf and a file with the job's engine. */
+static int job_io(struct job_thread *t, struct job_file *f, unsigned long long offset,
+                  unsigned char *buf, int reading){
+
+  unsigned long bs = t->job->bs;
+
+  switch(t->job->engine){
+  case ENGINE_MMAP:
+    if(reading) memcpy(buf, f->addr + offset, bs);
+    else memcpy(f->addr + offset, buf, bs);
+    return 0;
+
+#ifdef PMEM
+  case ENGINE_PMEM:
+    if(reading) memcpy(buf, f->addr + offset, bs);
+    else if(f->is_pmem) pmem_memcpy_nodrain(f->addr + offset, buf, bs);
+    else memcpy(f->addr + offset, buf, bs);
+    return 0;
+#endif
+
+  default:
+    if(reading) return pread(f->fd, buf, bs, offset) != bs;
+    return pwrite(f->fd, buf, bs, offset) != bs;
+  }
+
+}
+
+/* Make the block just written at offset durable. */
+static int job_sync(struct job_thread *t, struct job_file *f, unsigned long long offset){
+
+  long page = sysconf(_SC_PAGESIZE);
+  unsigned long long start;
+
+  switch(t->job->engine){
+  case ENGINE_MMAP:
+    start = offset - offset % page;
+    return msync(f->addr + start, offset + t->job->bs - start, MS_SYNC);
+
+#ifdef PMEM
+  case ENGINE_PMEM:
+    if(f->is_pmem){
+      pmem_drain();
+      return 0;
+    }
+    return pmem_msync(f->addr + offset, t->job->bs);
+#endif
+
+  default:
+    return t->job->fdatasync ? fdatasync(f->fd) : fsync(f->fd);
+  }
+
+}
+
+/* Time a sync after every sync-th write. */
+static void job_after_write(struct job_thread *t, struct job_file *f, unsigned long long offset){
+
+  struct timespec t1, t2;
+
+  t->writes++;
+  if(t->job->sync <= 0 || t->writes % t->job->sync != 0) return;
+
+  clock_gettime(CLOCK, &t1);
+  if(job_sync(t, f, offset) != 0) t->errors++;
+  clock_gettime(CLOCK, &t2);
+  hist_record(&t->hist[JOB_SYNC], time_diff(&t1, &t2));
+
+}
+
+/* One request at a time. */
+static void job_sync_loop(struct job_thread *t, unsigned char *buf){
+
+  struct timespec t1, t2;
+  unsigned long long i, block, offset;
+  struct job_file *f;
+  int reading;
+
+  for(i=0; i<t->ops; i++){
+    block = next_block(t, i);
+    f = &t->files[block / t->per_file];
+    offset = (block % t->per_file) * t->job->bs;
+    reading = next_is_read(t);
+
+    clock_gettime(CLOCK, &t1);
+    if(job_io(t, f, offset, buf, reading) != 0) t->errors++;
+    clock_gettime(CLOCK, &t2);
+    hist_record(&t->hist[reading ? JOB_READ : JOB_WRITE], time_diff(&t1, &t2));
+
+    if(!reading) job_after_write(t, f, offset);
+  }
+
+}
+
+#ifdef __linux__
+/* qd requests in flight through Linux AIO, posix engine only. */
+static void job_aio_loop(struct job_thread *t, unsigned char **buffers){
+
+  aio_context_t ctx = 0;
+  struct iocb cbs[AIO_MAX_QD];
+  struct iocb *cbp[AIO_MAX_QD];
+  struct io_event events[AIO_MAX_QD];
+  struct timespec submitted[AIO_MAX_QD];
+  struct timespec now;
+  unsigned long long issued = 0, done = 0, block;
+  unsigned int qd = t->job->qd;
+  struct job_file *f;
+  int i, n, slot, reading;
+
+  if(io_setup(qd, &ctx) != 0){
+    t->errors++;
+    return;
+  }
+  memset(cbs, 0, sizeof(cbs));
+
+  for(i=0; i<qd && issued<t->ops; i++, issued++){
+    block = next_block(t, issued);
+    reading = next_is_read(t);
+    cbs[i].aio_data = i;
+    cbs[i].aio_lio_opcode = reading ? IOCB_CMD_PREAD : IOCB_CMD_PWRITE;
+    cbs[i].aio_fildes = t->files[block / t->per_file].fd;
+    cbs[i].aio_buf = (unsigned long)buffers[i];
+    cbs[i].aio_nbytes = t->job->bs;
+    cbs[i].aio_offset = (block % t->per_file) * t->job->bs;
+    cbp[i] = &cbs[i];
+    clock_gettime(CLOCK, &submitted[i]);
+  }
+  if(i > 0 && io_submit(ctx, i, cbp) != i){
+    t->errors++;
+    io_destroy(ctx);
+    return;
+  }
+
+  while(done < t->ops){
+    n = io_getevents(ctx, 1, qd, events, NULL);
+    if(n < 0){
+      if(errno == EINTR) continue;
+      t->errors++;
+      break;
+    }
+    clock_gettime(CLOCK, &now);
+
+    for(i=0; i<n; i++){
+      slot = events[i].data;
+      reading = cbs[slot].aio_lio_opcode == IOCB_CMD_PREAD;
+      if(events[i].res != t->job->bs) t->errors++;
+      hist_record(&t->hist[reading ? JOB_READ : JOB_WRITE], time_diff(&submitted[slot], &now));
+      done++;
+
+      if(!reading){
+        for(f=t->files; f->fd!=cbs[slot].aio_fildes; f++);
+        job_after_write(t, f, cbs[slot].aio_offset);
+      }
+
+      if(issued < t->ops){
+        block = next_block(t, issued++);
+        reading = next_is_read(t);
+        cbs[slot].aio_lio_opcode = reading ? IOCB_CMD_PREAD : IOCB_CMD_PWRITE;
+        cbs[slot].aio_fildes = t->files[block / t->per_file].fd;
+        cbs[slot].aio_offset = (block % t->per_file) * t->job->bs;
+        cbp[0] = &cbs[slot];
+        clock_gettime(CLOCK, &submitted[slot]);
+        if(io_submit(ctx, 1, cbp) != 1){
+          t->errors++;
+          done = t->ops;
+          break;
+        }
+      }
+    }
+  }
+
+  io_destroy(ctx);
+
+}
+#endif
+
+static void *job_worker(void *arg){
+
+  struct job_thread *t = (struct job_thread *)arg;
+  unsigned char *buffers[AIO_MAX_QD];
+  unsigned int i, qd = t->job->engine == ENGINE_POSIX ? t->job->qd : 1;
+
+  if(qd == 0) qd = 1;
+
+  for(i=0; i<qd; i++){
+    if(posix_memalign((void **)&buffers[i], 4096, t->job->bs) != 0){
+      t->errors++;
+      while(i > 0) free(buffers[--i]);
+      return NULL;
+    }
+    memset(buffers[i], t->id + 1, t->job->bs);
+  }
+
+#ifdef __linux__
+  if(qd > 1) job_aio_loop(t, buffers);
+  else
+#endif
+  job_sync_loop(t, buffers[0]);
+
+#ifdef PMEM
+  /* the last writes of this thread are still to be drained */
+  if(t->job->engine == ENGINE_PMEM && t->job->sync == SYNC_END && t->files[0].is_pmem) pmem_drain();
+#endif
+
+  for(i=0; i<qd; i++){
+    free(buffers[i]);
+  }
+
+  return NULL;
+
+}
+
+/* Create the job's files full of data, then open or map them for the engine. */
+static int job_open_files(struct job *j, struct job_file *files){
+
+  unsigned char *data;
+  unsigned long long written;
+  unsigned int i;
+  int flags, chunk = 1 << 20;
+
+  data = malloc(chunk);
+  if(!data){
+    fprintf(stderr, "ERROR: out of memory in job %s\n", j->name);
+    return 1;
+  }
+  memset(data, 0x5a, chunk);
+
+  for(i=0; i<j->files; i++){
+    sprintf(files[i].name, "%s/%s_%u", j->directory, j->name, i);
+    files[i].fd = open(files[i].name, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+    if(files[i].fd < 0){
+      fprintf(stderr, "ERROR: unable to create %s in job %s\n", files[i].name, j->name);
+      return 1;
+    }
+    for(written=0; written<j->size; written+=chunk){
+      write(files[i].fd, data, j->size - written < chunk ? j->size - written : chunk);
+    }
+    fsync(files[i].fd);
+    close(files[i].fd);
+    files[i].fd = -1;
+    files[i].len = j->size;
+  }
+  free(data);
+
+  for(i=0; i<j->files; i++){
+    switch(j->engine){
+    case ENGINE_MMAP:
+      files[i].fd = open(files[i].name, O_RDWR);
+      if(files[i].fd < 0) break;
+      files[i].addr = mmap(NULL, j->size, PROT_READ|PROT_WRITE, MAP_SHARED, files[i].fd, 0);
+      if(files[i].addr == MAP_FAILED){
+        fprintf(stderr, "ERROR: unable to map %s in job %s\n", files[i].name, j->name);
+        return 1;
+      }
+      break;
+
+#ifdef PMEM
+    case ENGINE_PMEM:
+      files[i].addr = pmem_map_file(files[i].name, 0, 0, 0644, &files[i].len, &files[i].is_pmem);
+      if(files[i].addr == NULL){
+        fprintf(stderr, "ERROR: unable to map %s in job %s\n", files[i].name, j->name);
+        return 1;
+      }
+      files[i].fd = 0;
+      break;
+#endif
+
+    default:
+      flags = O_RDWR;
+#ifndef __MACH__
+      if(j->direct) flags |= O_DIRECT;
+#endif
+      files[i].fd = open(files[i].name, flags);
+      if(files[i].fd < 0 && errno == EINVAL && j->direct){
+        fprintf(stderr, "WARNING: O_DIRECT not supported for %s, using buffered I/O\n", files[i].name);
+        j->direct = 0;
+        files[i].fd = open(files[i].name, O_RDWR);
+      }
+    }
+
+    if(files[i].fd < 0){
+      fprintf(stderr, "ERROR: unable to open %s in job %s\n", files[i].name, j->name);
+      return 1;
+    }
+  }
+
+  return 0;
+
+}
+
+/* Make everything written durable at the end of a sync=end job. */
+static void job_sync_files(struct job *j, struct job_file *files){
+
+  unsigned int i;
+
+  for(i=0; i<j->files; i++){
+    switch(j->engine){
+    case ENGINE_MMAP:
+      msync(files[i].addr, j->size, MS_SYNC);
+      break;
+#ifdef PMEM
+    case ENGINE_PMEM:
+      /* the threads have drained, only page cache mappings need syncing */
+      if(!files[i].is_pmem) pmem_msync(files[i].addr, files[i].len);
+      break;
+#endif
+    default:
+      if(j->fdatasync) fdatasync(files[i].fd);
+      else fsync(files[i].fd);
+    }
+  }
+
+}
+
+static void job_close_files(struct job *j, struct job_file *files){
+
+  unsigned int i;
+
+  for(i=0; i<j->files; i++){
+    switch(j->engine){
+    case ENGINE_MMAP:
+      munmap(files[i].addr, j->size);
+      close(files[i].fd);
+      break;
+#ifdef PMEM
+    case ENGINE_PMEM:
+      pmem_unmap(files[i].addr, files[i].len);
+      break;
+#endif
+    default:
+      close(files[i].fd);
+    }
+    unlink(files[i].name);
+  }
+
+}
+
+static int run_job(struct job *j){
+
+  struct job_thread *threads;
+  struct job_file *files;
+  struct histogram total;
+  struct timespec start, end;
+  char titlebuffer[500];
+  char syncbuffer[32];
+  unsigned long long per_file, all_blocks, ops, moved = 0;
+  double duration;
+  int i, op, errors = 0;
+
+#ifndef PMEM
+  if(j->engine == ENGINE_PMEM){
+    fprintf(stderr, "ERROR: job %s needs the pmem engine, build with PMEM to use it\n", j->name);
+    return 1;
+  }
+#endif
+
+  per_file = j->size / j->bs;
+  if(per_file == 0){
+    fprintf(stderr, "ERROR: files in job %s are smaller than one block\n", j->name);
+    return 1;
+  }
+  j->size = per_file * j->bs;
+  all_blocks = per_file * j->files;
+  ops = j->ops ? j->ops : all_blocks;
+
+  if(j->engine != ENGINE_POSIX && j->qd > 1){
+    fprintf(stderr, "WARNING: qd only applies to the posix engine, job %s runs at qd 1\n", j->name);
+    j->qd = 1;
+  }
+#ifndef __linux__
+  j->qd = 1;
+#endif
+
+  threads = calloc(j->threads, sizeof(struct job_thread));
+  files = calloc(j->files, sizeof(struct job_file));
+  if(!threads || !files){
+    fprintf(stderr, "ERROR: out of memory in job %s\n", j->name);
+    return 1;
+  }
+
+  if(job_open_files(j, files) != 0) return 1;
+
+  /* each thread gets its share of the ops and, for sequential, of the blocks */
+  for(i=0; i<j->threads; i++){
+    threads[i].id = i;
+    threads[i].job = j;
+    threads[i].files = files;
+    threads[i].per_file = per_file;
+    threads[i].ops = ops / j->threads + (i < ops % j->threads ? 1 : 0);
+    threads[i].first = all_blocks * i / j->threads;
+    threads[i].blocks = all_blocks * (i + 1) / j->threads - threads[i].first;
+    if(threads[i].blocks == 0) threads[i].blocks = 1;
+    threads[i].x = 0x9E3779B97F4A7C15ULL * (i + 1);
+    for(op=0; op<NUM_JOB_OPS; op++){
+      hist_reset(&threads[i].hist[op], job_op_names[op]);
+    }
+  }
+
+  if(j->sync == SYNC_NONE) strcpy(syncbuffer, "none");
+  else if(j->sync == SYNC_END) strcpy(syncbuffer, "end");
+  else sprintf(syncbuffer, "every %d", j->sync);
+
+  sprintf(titlebuffer, "job %s: %s %s %s, %lu byte blocks, %u files of %llu bytes, %s, sync %s, %u threads, qd %u",
+          j->name, engine_names[j->engine], pattern_names[j->pattern], rw_names[j->rw], j->bs,
+          j->files, j->size, j->direct ? "direct" : "buffered", syncbuffer, j->threads, j->qd);
+
+  clock_gettime(CLOCK, &start);
+
+  for(i=0; i<j->threads; i++){
+    if(pthread_create(&threads[i].thread, NULL, job_worker, &threads[i]) != 0){
+      fprintf(stderr, "ERROR: unable to create thread in job %s\n", j->name);
+      return 1;
+    }
+  }
+  for(i=0; i<j->threads; i++){
+    pthread_join(threads[i].thread, NULL);
+  }
+  if(j->sync == SYNC_END) job_sync_files(j, files);
+
+  clock_gettime(CLOCK, &end);
+  duration = elapsed_time_hr(start, end, titlebuffer);
+
+  latency_header(titlebuffer);
+  for(op=0; op<NUM_JOB_OPS; op++){
+    hist_reset(&total, job_op_names[op]);
+    for(i=0; i<j->threads; i++){
+      hist_merge(&total, &threads[i].hist[op]);
+    }
+    if(op != JOB_SYNC) moved += total.n;
+    if(total.n > 0) latency_row(job_op_names[op], &total, total.n / duration);
+  }
+  printf("|\n");
+  printf("| IOPS: %.0f   Throughput: %.3f MB/s\n", moved / duration, moved * j->bs / duration / 1e6);
+  latency_footer();
+
+  for(i=0; i<j->threads; i++){
+    errors += threads[i].errors;
+  }
+  if(errors > 0){
+    fprintf(stderr, "ERROR: %d requests failed in job %s\n", errors, j->name);
+  }
+
+  job_close_files(j, files);
+  free(files);
+  free(threads);
+
+  return errors > 0;
+
+}
+
+/* Run every job in a job file, one after another. */
+int run_jobs(char *path){
+
+  struct job *jobs;
+  int n, i, errors = 0;
+
+  if(!path){
+    fprintf(stderr, "ERROR: give a job file with -j for the job benchmark\n");
+    return 1;
+  }
+
+  jobs = malloc(MAX_JOBS * sizeof(struct job));
+  if(!jobs){
+    fprintf(stderr, "ERROR: out of memory in run_jobs\n");
+    return 1;
+  }
+
+  n = parse_jobs(path, jobs);
+  if(n == 0) fprintf(stderr, "ERROR: no jobs in %s\n", path);
+
+  for(i=0; i<n; i++){
+    errors += run_job(&jobs[i]);
+  }
+
+  free(jobs);
+  fflush(stdout);
+
+  return n <= 0 || errors > 0;
+
+}
@@ -0,0 +1,303 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+/* need this to get MAP_ANONYMOUS, MAP_HUGETLB and MADV_HUGEPAGE */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "utils.h"
+#include "latency.h"
+
+#ifdef PMEM
+#include<libvmem.h>
+#endif
+
+/*
+ * Latency curve over working sets from 4 KB up: the lines of the working
+ * set are linked into one random cycle, a pointer at the start of each
+ * line, and C chasers start C evenly spaced points around the cycle. Each
+ * chaser's loads depend on each other but not on the other chasers', so
+ * with C chasers up to C misses can be outstanding at once.
+ */
+
+#define LINE_BYTES 64
+#define LAT_MIN_SET (4UL << 10)
+
+/* loads timed for each working set and number of chains */
+#define LAT_LOADS (1UL << 22)
+
+#define HUGE_PAGE (2UL << 20)
+
+#define NUM_CHAINS 5
+static unsigned int lat_chains[NUM_CHAINS] = {1, 2, 4, 8, 16};
+
+#define HOP(p) p = *(void **)p
+
+/* one chaser per variable, so every chaser stays in a register */
+static void *chase1(void **s, unsigned long n){
+  void *a = s[0];
+  while(n--){ HOP(a); }
+  return a;
+}
+
+static void *chase2(void **s, unsigned long n){
+  void *a = s[0], *b = s[1];
+  while(n--){ HOP(a); HOP(b); }
+  return (void *)((uintptr_t)a ^ (uintptr_t)b);
+}
+
+static void *chase4(void **s, unsigned long n){
+  void *a = s[0], *b = s[1], *c = s[2], *d = s[3];
+  while(n--){ HOP(a); HOP(b); HOP(c); HOP(d); }
+  return (void *)((uintptr_t)a ^ (uintptr_t)b ^ (uintptr_t)c ^ (uintptr_t)d);
+}
+
+static void *chase8(void **s, unsigned long n){
+  void *a = s[0], *b = s[1], *c = s[2], *d = s[3];
+  void *e = s[4], *f = s[5], *g = s[6], *h = s[7];
+  while(n--){ HOP(a); HOP(b); HOP(c); HOP(d); HOP(e); HOP(f); HOP(g); HOP(h); }
+  return (void *)((uintptr_t)a ^ (uintptr_t)b ^ (uintptr_t)c ^ (uintptr_t)d ^
+                  (uintptr_t)e ^ (uintptr_t)f ^ (uintptr_t)g ^ (uintptr_t)h);
+}
+
+static void *chase16(void **s, unsigned long n){
+  void *a = s[0], *b = s[1], *c = s[2], *d = s[3];
+  void *e = s[4], *f = s[5], *g = s[6], *h = s[7];
+  void *i = s[8], *j = s[9], *k = s[10], *l = s[11];
+  void *m = s[12], *o = s[13], *p = s[14], *q = s[15];
+  while(n--){
+    HOP(a); HOP(b); HOP(c); HOP(d); HOP(e); HOP(f); HOP(g); HOP(h);
+    HOP(i); HOP(j); HOP(k); HOP(l); HOP(m); HOP(o); HOP(p); HOP(q);
+  }
+  return (void *)((uintptr_t)a ^ (uintptr_t)b ^ (uintptr_t)c ^ (uintptr_t)d ^
+                  (uintptr_t)e ^ (uintptr_t)f ^ (uintptr_t)g ^ (uintptr_t)h ^
+                  (uintptr_t)i ^ (uintptr_t)j ^ (uintptr_t)k ^ (uintptr_t)l ^
+                  (uintptr_t)m ^ (uintptr_t)o ^ (uintptr_t)p ^ (uintptr_t)q);
+}
+
+static void *chase(unsigned int chains, void **starts, unsigned long n){
+
+  switch(chains){
+  case 1: return chase1(starts, n);
+  case 2: return chase2(starts, n);
+  case 4: return chase4(starts, n);
+  case 8: return chase8(starts, n);
+  default: return chase16(starts, n);
+  }
+
+}
+
+/*
+ * Link the lines of the first len bytes of array into a random cycle
+ * and put the line at each of the positions 0, L/16, 2L/16, ... of the
+ * cycle in positions[].
+ */
+static int lat_link(char *array, size_t len, void **positions){
+
+  size_t lines = len / LINE_BYTES;
+  size_t i, j;
+  uint32_t *order, tmp;
+
+  order = malloc(lines * sizeof(uint32_t));
+  if(!order) return 1;
+
+  for(i=0; i<lines; i++){
+    order[i] = i;
+  }
+  for(i=lines-1; i>0; i--){
+    j = ((size_t)rand() * ((size_t)RAND_MAX + 1) + rand()) % (i + 1);
+    tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+
+  for(i=0; i<lines; i++){
+    *(void **)(array + (size_t)order[i] * LINE_BYTES) = array + (size_t)order[(i + 1) % lines] * LINE_BYTES;
+  }
+  for(i=0; i<16; i++){
+    positions[i] = array + (size_t)order[i * lines / 16] * LINE_BYTES;
+  }
+
+  free(order);
+  return 0;
+
+}
+
+/*
+ * Print the latency curve over working sets from 4 KB up to len bytes of
+ * array, with 1, 2, 4, 8 and 16 chains. pages says what the array is
+ * mapped with.
+ */
+static int lat_sweep(char *op, char *array, size_t len, char *pages){
+
+  struct timespec start, end;
+  void *positions[16], *starts[16], *sink = NULL;
+  size_t set, lines;
+  unsigned long n;
+  double ns[NUM_CHAINS], best;
+  unsigned int c, k;
+  char label[20];
+
+  srand(getpid());
+
+  printf("\n--- %s: 4 KB to %zu MB, %s\n", op, len >> 20, pages);
+  printf("--- Timings ------------------------------------------------------------------------\n");
+  printf("|\n");
+  printf("| %10s", "Set");
+  for(c=0; c<NUM_CHAINS; c++){
+    sprintf(label, "%u chain%s", lat_chains[c], lat_chains[c] > 1 ? "s" : "");
+    printf(" %10s", label);
+  }
+  printf(" %8s\n", "MLP");
+
+  for(set=LAT_MIN_SET; set<=len; set*=2){
+    lines = set / LINE_BYTES;
+    if(lat_link(array, set, positions) != 0){
+      fprintf(stderr, "ERROR: out of memory in %s\n", op);
+      return 1;
+    }
+
+    best = 0.0;
+    for(c=0; c<NUM_CHAINS; c++){
+      /* chains start evenly spaced around the cycle */
+      for(k=0; k<lat_chains[c]; k++){
+        starts[k] = positions[k * 16 / lat_chains[c]];
+      }
+      n = LAT_LOADS / lat_chains[c];
+
+      /* warm up with one trip around the cycle, or as much as is timed */
+      sink = chase(lat_chains[c], starts, lines < n ? lines / lat_chains[c] : n);
+
+      clock_gettime(CLOCK, &start);
+      sink = chase(lat_chains[c], starts, n);
+      clock_gettime(CLOCK, &end);
+
+      ns[c] = 1e9 * time_diff(&start, &end) / ((double)n * lat_chains[c]);
+      if(c == 0 || ns[c] < best) best = ns[c];
+    }
+
+    if(set >= (1UL << 20)) sprintf(label, "%zu MB", set >> 20);
+    else sprintf(label, "%zu KB", set >> 10);
+    printf("| %10s", label);
+    for(c=0; c<NUM_CHAINS; c++){
+      printf(" %10.2f", ns[c]);
+    }
+    printf(" %8.1f\n", ns[0] / best);
+  }
+
+  /* make sure the compiler keeps the loads */
+  if(sink == NULL) printf("sink = %p\n", sink);
+
+  printf("|\n");
+  printf("| ns per load. With C chains a load takes C times this; MLP is the best speedup over one chain.\n");
+  printf("------------------------------------------------------------------------------------\n");
+  fflush(stdout);
+
+  return 0;
+
+}
+
+/*
+ * Latency curve of 'size' MB of memory, with 4 KB pages, or with huge
+ * pages if huge is set: explicit ones if any are reserved, else
+ * transparent ones.
+ */
+int read_lat_sweep(unsigned int size, int huge){
+
+  size_t len = (size_t)size << 20;
+  char *array = MAP_FAILED;
+  char *pages = "4 KB pages";
+  int err;
+
+  if(len < LAT_MIN_SET){
+    fprintf(stderr, "ERROR: read_lat_sweep needs at least 1 MB\n");
+    return 1;
+  }
+
+  if(huge){
+    len = (len + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+#ifdef MAP_HUGETLB
+    array = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    pages = "explicit huge pages";
+#endif
+  }
+  if(array == MAP_FAILED){
+    array = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(array == MAP_FAILED){
+      printf("Out Of Memory: could not allocate space for the array.\n");
+      return 0;
+    }
+    pages = "4 KB pages";
+#ifdef MADV_HUGEPAGE
+    if(huge && madvise(array, len, MADV_HUGEPAGE) == 0) pages = "transparent huge pages";
+    if(!huge) madvise(array, len, MADV_NOHUGEPAGE);
+#endif
+  }
+
+  err = lat_sweep("read_lat_sweep", array, len, pages);
+
+  munmap(array, len);
+
+  return err;
+
+}
+
+#ifdef PMEM
+/* Latency curve of 'size' MB of pmem.io vmem */
+int vmem_read_lat_sweep(unsigned int size, char *nvmelocation){
+
+  size_t len = (size_t)size << 20;
+  VMEM *vmp;
+  char *block, *array;
+  int err;
+
+  if(len < LAT_MIN_SET){
+    fprintf(stderr, "ERROR: read_vmem_lat_sweep needs at least 1 MB\n");
+    return 1;
+  }
+
+  if((vmp = vmem_create(nvmelocation, len + len/2 + VMEM_MIN_POOL)) == NULL){
+    perror("vmem_create");
+    exit(1);
+  }
+
+  if((block = (char *)vmem_malloc(vmp, len + LINE_BYTES)) == NULL){
+    perror("vmem_malloc");
+    exit(1);
+  }
+  /* the chains need the array aligned to a line */
+  array = block + (LINE_BYTES - (uintptr_t)block % LINE_BYTES) % LINE_BYTES;
+
+  err = lat_sweep("read_vmem_lat_sweep", array, len, "vmem");
+
+  vmem_free(vmp, block);
+  vmem_delete(vmp);
+
+  return err;
+
+}
+#endif
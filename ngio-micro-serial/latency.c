@@ -0,0 +1,188 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/* 
+* This software was developed as part of the                       
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)                 
+* www.nextgenio.eu           
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "utils.h"
+#include "latency.h"
+
+/* seconds between two timestamps */
+double time_diff(struct timespec *start, struct timespec *end){
+
+  return (end->tv_sec - start->tv_sec) + ((double)(end->tv_nsec - start->tv_nsec)/1000000000);
+
+}
+
+/* raw samples are written here as they are recorded, when it is open */
+static FILE *raw_file = NULL;
+
+static int hist_index(unsigned long long ns){
+
+  int msb, shift;
+
+  if(ns < (2ULL << HIST_SUB_BITS)) return (int)ns;
+
+  msb = 63 - __builtin_clzll(ns);
+  shift = msb - HIST_SUB_BITS;
+  if(shift >= HIST_MAX_BITS - HIST_SUB_BITS) return HIST_BUCKETS - 1;
+
+  return ((shift + 1) << HIST_SUB_BITS) + (int)((ns >> shift) - (1ULL << HIST_SUB_BITS));
+
+}
+
+/* a value in the middle of bucket i, in nanoseconds */
+static double hist_value(int i){
+
+  int shift;
+  unsigned long long low;
+
+  if(i < (2 << HIST_SUB_BITS)) return i;
+
+  shift = (i >> HIST_SUB_BITS) - 1;
+  low = ((unsigned long long)(i & ((1 << HIST_SUB_BITS) - 1)) + (1ULL << HIST_SUB_BITS)) << shift;
+
+  return low + ((1ULL << shift) - 1) / 2.0;
+
+}
+
+void hist_reset(struct histogram *h, char *name){
+
+  memset(h, 0, sizeof(struct histogram));
+  h->name = name;
+  h->min = ~0ULL;
+
+}
+
+/* Count one latency, given in seconds. */
+void hist_record(struct histogram *h, double seconds){
+
+  unsigned long long ns = seconds > 0 ? (unsigned long long)(seconds * 1e9 + 0.5) : 0;
+
+  h->count[hist_index(ns)]++;
+  h->n++;
+  h->sum += seconds;
+  if(ns < h->min) h->min = ns;
+  if(ns > h->max) h->max = ns;
+
+  if(raw_file) fprintf(raw_file, "%s,%llu\n", h->name, ns);
+
+}
+
+/* Add the counts of histogram from into h. */
+void hist_merge(struct histogram *h, struct histogram *from){
+
+  int i;
+
+  for(i=0; i<HIST_BUCKETS; i++){
+    h->count[i] += from->count[i];
+  }
+  h->n += from->n;
+  h->sum += from->sum;
+  if(from->min < h->min) h->min = from->min;
+  if(from->max > h->max) h->max = from->max;
+
+}
+
+/* The latency in seconds that fraction p of the samples are at or below. */
+double hist_percentile(struct histogram *h, double p){
+
+  unsigned long target, seen = 0;
+  double value;
+  int i;
+
+  if(h->n == 0) return 0.0;
+
+  target = (unsigned long)(p * h->n);
+  if(target >= h->n) target = h->n - 1;
+
+  for(i=0; i<HIST_BUCKETS; i++){
+    seen += h->count[i];
+    if(seen > target) break;
+  }
+
+  /* the exact extremes are known, keep bucket midpoints inside them */
+  value = hist_value(i);
+  if(value < h->min) value = h->min;
+  if(value > h->max) value = h->max;
+
+  return value / 1e9;
+
+}
+
+double hist_mean(struct histogram *h){
+
+  return h->n ? h->sum / h->n : 0.0;
+
+}
+
+/*
+ * Start writing every recorded sample to path, one "name,nanoseconds" line
+ * each, or stop if path is NULL.
+ */
+void latency_dump(char *path){
+
+  if(raw_file){
+    fclose(raw_file);
+    raw_file = NULL;
+  }
+
+  if(path){
+    raw_file = fopen(path, "w");
+    if(!raw_file){
+      fprintf(stderr, "ERROR: unable to open %s for the raw latency samples\n", path);
+      return;
+    }
+    fprintf(raw_file, "operation,latency_ns\n");
+  }
+
+}
+
+void latency_header(char *title){
+
+  printf("\n--- %s\n", title);
+  printf("--- Latencies (us) -----------------------------------------------------------------\n");
+  printf("|\n");
+  printf("| %-12s %10s %12s %9s %9s %9s %9s %9s %9s\n", "Operation", "Count", "Ops/s", "Min", "p50", "p90", "p99", "p99.9", "Max");
+
+}
+
+/* Print one row of the table: the rate and the latency percentiles of h. */
+void latency_row(char *op, struct histogram *h, double rate){
+
+  if(h->n == 0){
+    printf("| %-12s %10lu %12s\n", op, h->n, "-");
+    return;
+  }
+
+  printf("| %-12s %10lu %12.0f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n", op, h->n, rate,
+         h->min/1e3, 1e6*hist_percentile(h, 0.5), 1e6*hist_percentile(h, 0.9),
+         1e6*hist_percentile(h, 0.99), 1e6*hist_percentile(h, 0.999), h->max/1e3);
+
+}
+
+void latency_footer(void){
+
+  printf("|\n");
+  printf("------------------------------------------------------------------------------------\n");
+  fflush(stdout);
+
+}
@@ -0,0 +1,52 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/* 
+* This software was developed as part of the                       
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)                 
+* www.nextgenio.eu           
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+/* Per-operation latency statistics for the io benchmarks */
+
+#include <time.h>
+
+/*
+ * Log-linear (HDR style) histogram of latencies in nanoseconds: values
+ * below 2^(HIST_SUB_BITS+1) ns are counted exactly, larger ones in
+ * 2^HIST_SUB_BITS buckets per power of two, so every value is held to
+ * within about 3%, up to 2^HIST_MAX_BITS ns (over 18 minutes).
+ */
+#define HIST_SUB_BITS 5
+#define HIST_MAX_BITS 40
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+struct histogram {
+  char *name;
+  unsigned long count[HIST_BUCKETS];
+  unsigned long n;
+  unsigned long long min, max;
+  double sum;
+};
+
+double time_diff(struct timespec *, struct timespec *);
+void hist_reset(struct histogram *, char *);
+void hist_record(struct histogram *, double);
+void hist_merge(struct histogram *, struct histogram *);
+double hist_percentile(struct histogram *, double);
+double hist_mean(struct histogram *);
+void latency_dump(char *);
+void latency_header(char *);
+void latency_row(char *, struct histogram *, double);
+void latency_footer(void);
@@ -33,6 +33,7 @@
 #include <limits.h>
 
 #include "level0.h"
+#include "latency.h"
 
 /*
  *
@@ -45,6 +46,17 @@ pthread_t callThd[2] = {0};
 int p_flag = 0;
 int flag_start = 0;
 pthread_attr_t attr;
+unsigned int num_threads = 1;
+unsigned int queue_depth = 0;
+unsigned int block_size = 4096;
+unsigned int num_files = 1;
+unsigned int batch_size = 8;
+int io_histograms = 0;
+char *raw_latencies = NULL;
+char *job_file = NULL;
+unsigned int commit_timeout = 1000;
+char *copy_dir = NULL;
+int huge_pages = 0;
 
 /*
  *
@@ -135,6 +147,14 @@ void bench_level0(char *b, unsigned int s, unsigned int t, unsigned long r, char
       vmem_read_lat(s, pmem_loc);
 #endif
 
+    else if(strcmp(o, "read_lat_sweep") == 0)
+      read_lat_sweep(s, huge_pages);
+
+#ifdef PMEM
+    else if(strcmp(o, "read_vmem_lat_sweep") == 0)
+      vmem_read_lat_sweep(s, pmem_loc);
+#endif
+
     else if(strcmp(o, "read_strided") == 0)
       mem_read_strided(s, t);
 
@@ -151,6 +171,20 @@ void bench_level0(char *b, unsigned int s, unsigned int t, unsigned long r, char
       vmem_read_random(s, pmem_loc);
 #endif
 
+    else if(strcmp(o, "read_bw") == 0)
+      mem_bw_dram(s, t, num_threads, 0);
+
+    else if(strcmp(o, "write_bw") == 0)
+      mem_bw_dram(s, t, num_threads, 1);
+
+#ifdef PMEM
+    else if(strcmp(o, "read_vmem_bw") == 0)
+      mem_bw_vmem(s, t, num_threads, 0, pmem_loc);
+
+    else if(strcmp(o, "write_vmem_bw") == 0)
+      mem_bw_vmem(s, t, num_threads, 1, pmem_loc);
+#endif
+
     else fprintf(stderr, "ERROR: check you are using a valid operation type...\n");
   }
 
@@ -170,6 +204,8 @@ void bench_level0(char *b, unsigned int s, unsigned int t, unsigned long r, char
   /* IO operations */
   else if(strcmp(b, "io") == 0){
 
+    if(raw_latencies) latency_dump(raw_latencies);
+
     if(strcmp(o, "mk_rm_dir") == 0)
       mk_rm_dir(s);
 
@@ -179,6 +215,9 @@ void bench_level0(char *b, unsigned int s, unsigned int t, unsigned long r, char
 #ifdef PMEM
     else if(strcmp(o, "file_pmem_write") == 0)
       pmem_file_write(s, pmem_loc);
+
+    else if(strcmp(o, "pmem_pool_write") == 0)
+      pmem_pool_write(s, pmem_loc);
 #endif
 
     else if(strcmp(o, "file_read") == 0)
@@ -213,7 +252,67 @@ void bench_level0(char *b, unsigned int s, unsigned int t, unsigned long r, char
       file_read_random_direct(s);
 #endif
 
+    else if(strcmp(o, "file_write_random_compare") == 0)
+      file_random_compare(s, batch_size, 1);
+
+    else if(strcmp(o, "file_read_random_compare") == 0)
+      file_random_compare(s, batch_size, 0);
+
+    else if(strcmp(o, "metadata_shared") == 0)
+      metadata_ops(s, num_threads, 1);
+
+    else if(strcmp(o, "metadata_private") == 0)
+      metadata_ops(s, num_threads, 0);
+
+    else if(strcmp(o, "aio_read_random") == 0)
+      aio_random(s, num_files, block_size, queue_depth, r, 0);
+
+    else if(strcmp(o, "aio_write_random") == 0)
+      aio_random(s, num_files, block_size, queue_depth, r, 1);
+
+    else if(strcmp(o, "job") == 0)
+      run_jobs(job_file);
+
+    else if(strcmp(o, "file_mmap_read") == 0)
+      file_mmap(s, block_size, 0, 0);
+
+    else if(strcmp(o, "file_mmap_read_random") == 0)
+      file_mmap(s, block_size, 0, 1);
+
+    else if(strcmp(o, "file_mmap_write") == 0)
+      file_mmap(s, block_size, 1, 0);
+
+    else if(strcmp(o, "file_mmap_write_random") == 0)
+      file_mmap(s, block_size, 1, 1);
+
+    else if(strcmp(o, "file_write_prealloc") == 0)
+      file_prealloc(s, block_size);
+
+    else if(strcmp(o, "file_copy") == 0)
+      file_copy(s, copy_dir);
+
+#ifndef __MACH__
+    else if(strcmp(o, "file_read_direct_sweep") == 0)
+      file_direct_sweep(s, 0);
+
+    else if(strcmp(o, "file_write_direct_sweep") == 0)
+      file_direct_sweep(s, 1);
+#endif
+
+    else if(strcmp(o, "wal_fsync") == 0)
+      wal_bench(s, num_threads, block_size, batch_size, commit_timeout, 0, ".");
+
+    else if(strcmp(o, "wal_group") == 0)
+      wal_bench(s, num_threads, block_size, batch_size, commit_timeout, 1, ".");
+
+#ifdef PMEM
+    else if(strcmp(o, "wal_pmem") == 0)
+      wal_bench(s, num_threads, block_size, batch_size, commit_timeout, 2, pmem_loc);
+#endif
+
     else fprintf(stderr, "ERROR: check you are using a valid operation type...\n");
+
+    if(raw_latencies) latency_dump(NULL);
   }
 
   /* IPC operations */
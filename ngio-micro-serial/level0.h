@@ -34,6 +34,33 @@ extern int p_flag;
 extern int flag_start;
 extern pthread_attr_t attr;
 
+/* number of threads for the threaded io benchmarks */
+extern unsigned int num_threads;
+
+/* asynchronous io benchmark parameters */
+extern unsigned int queue_depth;
+extern unsigned int block_size;
+extern unsigned int num_files;
+
+/* blocks per preadv/pwritev call */
+extern unsigned int batch_size;
+
+/* time each io operation into a histogram, and where to dump the samples */
+extern int io_histograms;
+extern char *raw_latencies;
+
+/* job file for the job io benchmark */
+extern char *job_file;
+
+/* longest a group commit waits for its batch to fill, in microseconds */
+extern unsigned int commit_timeout;
+
+/* second directory for the file_copy io benchmark to copy into */
+extern char *copy_dir;
+
+/* back the read_lat_sweep memory benchmark with huge pages */
+extern int huge_pages;
+
 struct ipc_thread_info {
   unsigned long iteration;
   unsigned int payload_size;
@@ -88,6 +115,14 @@ int read_lat(unsigned int);
 #ifdef PMEM
 int vmem_read_lat(unsigned int, char*);
 #endif
+int read_lat_sweep(unsigned int, int);
+#ifdef PMEM
+int vmem_read_lat_sweep(unsigned int, char*);
+#endif
+int mem_bw_dram(unsigned int, unsigned int, unsigned int, int);
+#ifdef PMEM
+int mem_bw_vmem(unsigned int, unsigned int, unsigned int, int, char*);
+#endif
 /* Function calls */
 int function_calls(unsigned int);
 int function_calls_recursive(unsigned int);
@@ -97,6 +132,7 @@ int mk_rm_dir(unsigned int);
 int file_write(unsigned int);
 #ifdef PMEM
 int pmem_file_write(unsigned int, char*);
+int pmem_pool_write(unsigned int, char*);
 #endif
 int file_write_random(unsigned int);
 #ifdef PMEM
@@ -115,7 +151,16 @@ int pmem_file_read_random(unsigned int, char*);
 #endif
 #ifndef __MACH__
 int file_read_random_direct(unsigned int);
-#endif
+int file_direct_sweep(unsigned int, int);
+#endif
+int file_random_compare(unsigned int, unsigned int, int);
+int run_jobs(char *);
+int file_mmap(unsigned int, unsigned int, int, int);
+int file_prealloc(unsigned int, unsigned int);
+int file_copy(unsigned int, char *);
+int wal_bench(unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, int, char *);
+int metadata_ops(unsigned int, unsigned int, int);
+int aio_random(unsigned int, unsigned int, unsigned int, unsigned int, unsigned long, int);
 
 /* IPC operations */
 int ipcmain(char *, unsigned long, unsigned int);
@@ -58,6 +58,17 @@ int main(int argc, char **argv){
       {"reps", required_argument, NULL, 'r'},
       {"op", required_argument, NULL, 'o'},
       {"dtype", required_argument, NULL, 'd'},
+      {"threads", required_argument, NULL, 'T'},
+      {"qdepth", required_argument, NULL, 'q'},
+      {"block", required_argument, NULL, 'k'},
+      {"files", required_argument, NULL, 'n'},
+      {"batch", required_argument, NULL, 'K'},
+      {"histogram", no_argument, NULL, 'H'},
+      {"dump", required_argument, NULL, 'D'},
+      {"job", required_argument, NULL, 'j'},
+      {"timeout", required_argument, NULL, 'w'},
+      {"copy_dir", required_argument, NULL, 'c'},
+      {"huge", no_argument, NULL, 'P'},
 #ifdef PMEM
       {"pmem_loc", required_argument, NULL, 'l'},
 #endif
@@ -67,9 +78,9 @@ int main(int argc, char **argv){
     };
 
 #ifdef PMEM
-  while((c = getopt_long(argc, argv, "b:s:t:r:o:d:l:ih", option_list, NULL)) != -1){
+  while((c = getopt_long(argc, argv, "b:s:t:r:o:d:T:q:k:n:K:HD:j:w:c:Pl:ih", option_list, NULL)) != -1){
 #else
-  while((c = getopt_long(argc, argv, "b:s:t:r:o:d:ih", option_list, NULL)) != -1){
+  while((c = getopt_long(argc, argv, "b:s:t:r:o:d:T:q:k:n:K:HD:j:w:c:Pih", option_list, NULL)) != -1){
 #endif
     switch(c){
     case 'b':
@@ -96,6 +107,50 @@ int main(int argc, char **argv){
       dt = optarg;
       printf("Data type is %s\n", dt);
       break;
+    case 'T':
+      num_threads = atoi(optarg);
+      printf("Number of threads %u.\n", num_threads);
+      break;
+    case 'q':
+      queue_depth = atoi(optarg);
+      printf("Queue depth %u.\n", queue_depth);
+      break;
+    case 'k':
+      block_size = atoi(optarg);
+      printf("Block size is %u bytes.\n", block_size);
+      break;
+    case 'n':
+      num_files = atoi(optarg);
+      printf("Number of files %u.\n", num_files);
+      break;
+    case 'K':
+      batch_size = atoi(optarg);
+      printf("Batch size %u.\n", batch_size);
+      break;
+    case 'H':
+      io_histograms = 1;
+      printf("Timing each io operation.\n");
+      break;
+    case 'D':
+      raw_latencies = optarg;
+      printf("Raw latency samples will be written to %s\n", raw_latencies);
+      break;
+    case 'j':
+      job_file = optarg;
+      printf("Job file is %s\n", job_file);
+      break;
+    case 'w':
+      commit_timeout = atoi(optarg);
+      printf("Group commit timeout is %u us.\n", commit_timeout);
+      break;
+    case 'c':
+      copy_dir = optarg;
+      printf("Files will also be copied to %s\n", copy_dir);
+      break;
+    case 'P':
+      huge_pages = 1;
+      printf("Using huge pages.\n");
+      break;
 #ifdef PMEM
     case 'l':
       pmem_loc = optarg;
@@ -132,8 +187,11 @@ void usage(){
   printf("\t -s, --size N \t\t number of elements/files/directories. Default is 200.\n");
   printf("\t\t\t\t  --> for the function benchmark, this value should be set to at least 100 million.\n");
   printf("\t\t\t\t  --> for the memory benchmark, this value should be the amount of memory to allocate/use in MBytes.\n");
+  printf("\t\t\t\t  --> for the aio, file_mmap, direct_sweep and file_copy io benchmarks, this value should be the size of each file in MBytes,\n");
+  printf("\t\t\t\t  and for file_write_prealloc the largest file size and the MBytes written for each file size.\n");
   printf("\t\t\t\t  --> for the sleep benchmark, this value should be the duration to sleep for in seconds.\n");
-  printf("\t -t, --stride N \t optional stride value (in KB) for memory benchmarks write_strided and read_strided. Default is 64KB.\n");
+  printf("\t -t, --stride N \t optional stride value (in KB) for memory benchmarks write_strided and read_strided,\n");
+  printf("\t\t\t\t and the largest stride for the bandwidth memory benchmarks. Default is 64KB.\n");
   printf("\t -r, --reps N \t\t number of repetitions. Default value is ULONG_MAX.\n");
   printf("\t -o, --op TYPE \t\t TYPE of operation.\n");
   printf("\t\t\t\t --> for basic_op benchmark: \"+\", \"-\", \"*\" and \"/\". Default is \"+\".\n");
@@ -142,11 +200,22 @@ void usage(){
 #else
   printf("\t\t\t\t --> for memory   benchmark: \"calloc\", \"read_ram\", \"read_lat\", \"write_contig\", \"write_strided\", \"write_random\",\n");
 #endif
-  printf("\t\t\t\t \"read_contig\", \"read_strided\", \"read_random\".\n");
 #ifdef PMEM
-  printf("\t\t\t\t --> for IO benchmark: \"mk_rm_dir\", \"file_write\", \"file_read\", \"file_write_random\", \"file_read_random\", \"file_read_direct\", \"file_read_random_direct\".\n");
+  printf("\t\t\t\t \"read_contig\", \"read_strided\", \"read_random\", \"read_bw\", \"read_vmem_bw\", \"write_bw\", \"write_vmem_bw\",\n");
+  printf("\t\t\t\t \"read_lat_sweep\", \"read_vmem_lat_sweep\".\n");
+#else
+  printf("\t\t\t\t \"read_contig\", \"read_strided\", \"read_random\", \"read_bw\", \"write_bw\", \"read_lat_sweep\".\n");
+#endif
+#ifdef PMEM
+  printf("\t\t\t\t --> for IO benchmark: \"mk_rm_dir\", \"file_write\", \"file_pmem_write\", \"file_read\", \"file_pmem_read\", \"file_write_random\", \"file_read_random\", \"file_read_direct\", \"file_read_random_direct\", \"file_write_random_compare\", \"file_read_random_compare\", \"metadata_shared\", \"metadata_private\", \"aio_read_random\", \"aio_write_random\", \"job\",\n");
+  printf("\t\t\t\t \"file_mmap_read\", \"file_mmap_read_random\", \"file_mmap_write\", \"file_mmap_write_random\", \"pmem_pool_write\",\n");
+  printf("\t\t\t\t \"wal_fsync\", \"wal_group\", \"wal_pmem\", \"file_write_prealloc\", \"file_read_direct_sweep\", \"file_write_direct_sweep\",\n");
+  printf("\t\t\t\t \"file_copy\".\n");
 #else
-  printf("\t\t\t\t --> for IO benchmark: \"mk_rm_dir\", \"file_write\", \"file_pmem_write\", \"file_read\", \"file_pmem_read\", \"file_write_random\", \"file_read_random\", \"file_read_direct\", \"file_read_random_direct\".\n");
+  printf("\t\t\t\t --> for IO benchmark: \"mk_rm_dir\", \"file_write\", \"file_read\", \"file_write_random\", \"file_read_random\", \"file_read_direct\", \"file_read_random_direct\", \"file_write_random_compare\", \"file_read_random_compare\", \"metadata_shared\", \"metadata_private\", \"aio_read_random\", \"aio_write_random\", \"job\",\n");
+  printf("\t\t\t\t \"file_mmap_read\", \"file_mmap_read_random\", \"file_mmap_write\", \"file_mmap_write_random\", \"wal_fsync\", \"wal_group\",\n");
+  printf("\t\t\t\t \"file_write_prealloc\", \"file_read_direct_sweep\", \"file_write_direct_sweep\",\n");
+  printf("\t\t\t\t \"file_copy\".\n");
 #endif
   printf("\t\t\t\t --> for function benchmark: \"normal\", \"recursive\".\n");  
   printf("\t\t\t\t --> for ipc benchmark: \"SHM\", \"FIFO\", \"SOCK\".\n");  
@@ -157,6 +226,20 @@ void usage(){
 #ifdef PMEM
   printf("\t -l, --pmem_loc FILE_PATH \t\t FILE_PATH of NVMe enabled device where pmem files will be created.\n");
 #endif
+  printf("\t -T, --threads N \t number of threads for the metadata and wal io benchmarks and the bandwidth memory benchmarks. Default is 1.\n");
+  printf("\t -q, --qdepth N \t queue depth for the aio io benchmarks. Default is 0, which sweeps 1, 2, 4, ... 256.\n");
+  printf("\t -k, --block N \t\t block size in bytes for the aio io benchmarks (a multiple of 512), the file_mmap and file_write_prealloc\n");
+  printf("\t\t\t\t io benchmarks, and the largest record for the wal io benchmarks. Default is 4096.\n");
+  printf("\t -n, --files N \t\t number of files the aio io benchmarks spread requests over. Default is 1.\n");
+  printf("\t -K, --batch N \t\t blocks per preadv/pwritev call for the file_write_random_compare and file_read_random_compare io benchmarks,\n");
+  printf("\t\t\t\t and records per group commit for wal_group. Default is 8.\n");
+  printf("\t -H, --histogram \t time every open, write, fsync, read and close of the file_write, file_read, file_write_random, file_read_random\n");
+  printf("\t\t\t\t and direct io benchmarks, and report latency percentiles and throughput for each block size.\n");
+  printf("\t -D, --dump FILE \t write every latency sample recorded by the io benchmarks to FILE.\n");
+  printf("\t -j, --job FILE \t job file describing the workloads run by the job io benchmark, see example.job.\n");
+  printf("\t -w, --timeout N \t longest time in microseconds wal_group waits for a batch to fill before committing it. Default is 1000.\n");
+  printf("\t -c, --copy_dir DIR \t directory, typically on another filesystem, file_copy also copies into. Default is none.\n");
+  printf("\t -P, --huge \t\t back the array of read_lat_sweep with huge pages, explicit ones if reserved, else transparent ones.\n");
   printf("\t -d, --dtype DATATYPE \t DATATYPE to be used - possible values are int, long, float, double. Default is int.\n");
   printf("\t -i, --info \t\t Print out system information such as current CPU frequency, core counts, cache size, plus datatype sizes.\n");
   printf("\t -h, --help \t\t Displays this help.\n");
@@ -0,0 +1,350 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "latency.h"
+
+#ifdef PMEM
+#include<libvmem.h>
+#endif
+
+/*
+ * Memory bandwidth kernels: T threads each sweep their own part of an
+ * array a cache line at a time with the widest vector loads or stores the
+ * compiler targets, so the loop costs next to nothing beside the memory
+ * traffic. Contiguous sweeps touch every line, strided sweeps one line in
+ * every stride bytes. Each kernel can prefetch lines ahead in software,
+ * and stores can be non-temporal, bypassing the caches.
+ */
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VEC_NAME "AVX"
+#define VEC_BYTES 32
+typedef __m256d vec_t;
+#define VEC_ZERO() _mm256_setzero_pd()
+#define VEC_SET(x) _mm256_set1_pd(x)
+#define VEC_LOAD(p) _mm256_load_pd((double *)(p))
+#define VEC_STORE(p, v) _mm256_store_pd((double *)(p), v)
+#define VEC_STREAM(p, v) _mm256_stream_pd((double *)(p), v)
+#define VEC_OR(a, b) _mm256_or_pd(a, b)
+#define VEC_FENCE() _mm_sfence()
+#define VEC_HAS_STREAM 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VEC_NAME "SSE2"
+#define VEC_BYTES 16
+typedef __m128d vec_t;
+#define VEC_ZERO() _mm_setzero_pd()
+#define VEC_SET(x) _mm_set1_pd(x)
+#define VEC_LOAD(p) _mm_load_pd((double *)(p))
+#define VEC_STORE(p, v) _mm_store_pd((double *)(p), v)
+#define VEC_STREAM(p, v) _mm_stream_pd((double *)(p), v)
+#define VEC_OR(a, b) _mm_or_pd(a, b)
+#define VEC_FENCE() _mm_sfence()
+#define VEC_HAS_STREAM 1
+#else
+#define VEC_NAME "scalar"
+#define VEC_BYTES 8
+typedef uint64_t vec_t;
+#define VEC_ZERO() 0
+#define VEC_SET(x) ((uint64_t)(x))
+#define VEC_LOAD(p) (*(volatile uint64_t *)(p))
+#define VEC_STORE(p, v) (*(volatile uint64_t *)(p) = (v))
+#define VEC_STREAM(p, v) VEC_STORE(p, v)
+#define VEC_OR(a, b) ((a) | (b))
+#define VEC_FENCE()
+#define VEC_HAS_STREAM 0
+#endif
+
+#define LINE_BYTES 64
+#define LINE_VECS (LINE_BYTES / VEC_BYTES)
+
+/* lines a software prefetch reaches ahead */
+#define BW_PREFETCH_LINES 16
+
+/* each measurement sweeps the array until it has moved about this much */
+#define BW_BYTES (2UL << 30)
+
+#define BW_PLAIN 0
+#define BW_PREFETCH 1
+#define BW_STREAM 2
+#define NUM_BW_KERNELS 3
+
+static char *bw_kernel_names[2][NUM_BW_KERNELS] = {{"load", "load+prefetch", ""},
+                                                    {"store", "store+prefetch", "stream"}};
+
+struct bw_thread {
+  pthread_t thread;
+  char *start;
+  char *end;
+  size_t stride;
+  unsigned long passes;
+  int writing;
+  int kernel;
+  uint64_t sink;
+};
+
+/* start line for the threads, so they all sweep at the same time */
+static pthread_mutex_t bw_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bw_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int bw_ready;
+static int bw_go;
+
+static uint64_t bw_read(char *p, char *end, size_t stride, int prefetch){
+
+  vec_t acc[LINE_VECS];
+  uint64_t words[VEC_BYTES / 8], sum = 0;
+  int v;
+
+  for(v=0; v<LINE_VECS; v++) acc[v] = VEC_ZERO();
+
+  if(prefetch){
+    for(; p<end; p+=stride){
+      __builtin_prefetch(p + BW_PREFETCH_LINES * stride, 0, 3);
+      for(v=0; v<LINE_VECS; v++) acc[v] = VEC_OR(acc[v], VEC_LOAD(p + v * VEC_BYTES));
+    }
+  }
+  else{
+    for(; p<end; p+=stride){
+      for(v=0; v<LINE_VECS; v++) acc[v] = VEC_OR(acc[v], VEC_LOAD(p + v * VEC_BYTES));
+    }
+  }
+
+  /* fold the accumulators so the loads can't be optimised away */
+  for(v=0; v<LINE_VECS; v++){
+    memcpy(words, &acc[v], VEC_BYTES);
+    sum ^= words[0];
+  }
+  return sum;
+
+}
+
+static void bw_write(char *p, char *end, size_t stride, int kernel){
+
+  vec_t x = VEC_SET(1.0);
+  int v;
+
+  switch(kernel){
+  case BW_PREFETCH:
+    for(; p<end; p+=stride){
+      __builtin_prefetch(p + BW_PREFETCH_LINES * stride, 1, 3);
+      for(v=0; v<LINE_VECS; v++) VEC_STORE(p + v * VEC_BYTES, x);
+    }
+    break;
+  case BW_STREAM:
+    for(; p<end; p+=stride){
+      for(v=0; v<LINE_VECS; v++) VEC_STREAM(p + v * VEC_BYTES, x);
+    }
+    VEC_FENCE();
+    break;
+  default:
+    for(; p<end; p+=stride){
+      for(v=0; v<LINE_VECS; v++) VEC_STORE(p + v * VEC_BYTES, x);
+    }
+  }
+
+}
+
+static void *bw_thread_run(void *arg){
+
+  struct bw_thread *t = (struct bw_thread *)arg;
+  unsigned long i;
+
+  pthread_mutex_lock(&bw_lock);
+  bw_ready++;
+  pthread_cond_broadcast(&bw_cond);
+  while(!bw_go) pthread_cond_wait(&bw_cond, &bw_lock);
+  pthread_mutex_unlock(&bw_lock);
+
+  for(i=0; i<t->passes; i++){
+    if(t->writing) bw_write(t->start, t->end, t->stride, t->kernel);
+    else t->sink ^= bw_read(t->start, t->end, t->stride, t->kernel == BW_PREFETCH);
+  }
+
+  return NULL;
+
+}
+
+/*
+ * Sweep nbytes at array with T threads, a line every stride bytes, with
+ * a kernel. Returns the bandwidth in GB/s counting whole lines, or a
+ * negative value if out of memory.
+ */
+static double bw_run(char *array, size_t nbytes, size_t stride, unsigned int T, int writing, int kernel){
+
+  struct bw_thread *threads;
+  struct timespec start, end;
+  size_t share, lines = 0;
+  unsigned long passes;
+  unsigned int i;
+  uint64_t sink = 0;
+
+  threads = calloc(T, sizeof(struct bw_thread));
+  if(!threads) return -1.0;
+
+  /* each thread gets a contiguous share, a whole number of strides long */
+  share = nbytes / T;
+  share -= share % stride;
+  passes = BW_BYTES / (share * T / stride * LINE_BYTES);
+  if(passes == 0) passes = 1;
+
+  bw_ready = 0;
+  bw_go = 0;
+  for(i=0; i<T; i++){
+    threads[i].start = array + i * share;
+    threads[i].end = threads[i].start + share;
+    threads[i].stride = stride;
+    threads[i].passes = passes;
+    threads[i].writing = writing;
+    threads[i].kernel = kernel;
+    lines += share / stride;
+    if(pthread_create(&threads[i].thread, NULL, bw_thread_run, &threads[i]) != 0){
+      fprintf(stderr, "ERROR: unable to create thread %u in bw_run\n", i);
+      exit(1);
+    }
+  }
+
+  pthread_mutex_lock(&bw_lock);
+  while(bw_ready < T) pthread_cond_wait(&bw_cond, &bw_lock);
+  clock_gettime(CLOCK, &start);
+  bw_go = 1;
+  pthread_cond_broadcast(&bw_cond);
+  pthread_mutex_unlock(&bw_lock);
+
+  for(i=0; i<T; i++){
+    pthread_join(threads[i].thread, NULL);
+    sink ^= threads[i].sink;
+  }
+  clock_gettime(CLOCK, &end);
+
+  /* make sure the compiler keeps the loads */
+  if(sink == 1) printf("sink = %llu\n", (unsigned long long)sink);
+
+  free(threads);
+
+  return (double)passes * lines * LINE_BYTES / time_diff(&start, &end) / 1e9;
+
+}
+
+/*
+ * Run every kernel over the array, contiguously and then at every stride
+ * from two lines up to stride KB, and print the bandwidths.
+ */
+static int mem_bw(char *op, char *array, size_t nbytes, unsigned int stride, unsigned int T, int writing){
+
+  size_t s, max_stride = (size_t)stride * 1024;
+  double gbs;
+  int kernel;
+
+  if(T == 0) T = 1;
+  if(max_stride < LINE_BYTES) max_stride = LINE_BYTES;
+  if(nbytes < (size_t)T * max_stride){
+    fprintf(stderr, "ERROR: %s needs at least one stride of %zu bytes per thread\n", op, max_stride);
+    return 1;
+  }
+
+  /* fault the pages in before timing */
+  memset(array, 0x5a, nbytes);
+
+  printf("\n--- %s: %zu MB, %u threads, %s vectors\n", op, nbytes >> 20, T, VEC_NAME);
+  printf("--- Timings ------------------------------------------------------------------------\n");
+  printf("|\n");
+  printf("| %-12s %10s %-16s %10s\n", "Access", "Stride", "Kernel", "GB/s");
+
+  for(s=LINE_BYTES; s<=max_stride; s*=2){
+    for(kernel=0; kernel<NUM_BW_KERNELS; kernel++){
+      if(kernel == BW_STREAM && (!writing || !VEC_HAS_STREAM)) continue;
+
+      gbs = bw_run(array, nbytes, s, T, writing, kernel);
+      if(gbs < 0){
+        fprintf(stderr, "ERROR: out of memory in %s\n", op);
+        return 1;
+      }
+      printf("| %-12s %10zu %-16s %10.2f\n", s == LINE_BYTES ? "contiguous" : "strided", s,
+             bw_kernel_names[writing][kernel], gbs);
+    }
+  }
+
+  printf("|\n");
+  printf("| Strided sweeps count the whole %d byte line moved for each access.\n", LINE_BYTES);
+  printf("------------------------------------------------------------------------------------\n");
+  fflush(stdout);
+
+  return 0;
+
+}
+
+/* read or write 'size' MB of memory with the bandwidth kernels */
+int mem_bw_dram(unsigned int size, unsigned int stride, unsigned int T, int writing){
+
+  size_t nbytes = (size_t)size << 20;
+  char *array;
+  int err;
+
+  if(posix_memalign((void **)&array, 4096, nbytes) != 0){
+    printf("Out Of Memory: could not allocate space for the array.\n");
+    return 0;
+  }
+
+  err = mem_bw(writing ? "write_bw" : "read_bw", array, nbytes, stride, T, writing);
+
+  free(array);
+
+  return err;
+
+}
+
+#ifdef PMEM
+/* read or write 'size' MB of pmem.io vmem with the bandwidth kernels */
+int mem_bw_vmem(unsigned int size, unsigned int stride, unsigned int T, int writing, char *nvmelocation){
+
+  size_t nbytes = (size_t)size << 20;
+  VMEM *vmp;
+  char *block, *array;
+  int err;
+
+  if((vmp = vmem_create(nvmelocation, nbytes + nbytes/2 + VMEM_MIN_POOL)) == NULL){
+    perror("vmem_create");
+    exit(1);
+  }
+
+  if((block = (char *)vmem_malloc(vmp, nbytes + LINE_BYTES)) == NULL){
+    perror("vmem_malloc");
+    exit(1);
+  }
+  /* the kernels need the array aligned to a line */
+  array = block + (LINE_BYTES - (uintptr_t)block % LINE_BYTES) % LINE_BYTES;
+
+  err = mem_bw(writing ? "write_vmem_bw" : "read_vmem_bw", array, nbytes, stride, T, writing);
+
+  vmem_free(vmp, block);
+  vmem_delete(vmp);
+
+  return err;
+
+}
+#endif
@@ -0,0 +1,251 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/* 
+* This software was developed as part of the                       
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)                 
+* www.nextgenio.eu           
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "latency.h"
+
+#define MD_CREATE 0
+#define MD_CLOSE 1
+#define MD_STAT 2
+#define MD_OPEN 3
+#define MD_RENAME 4
+#define MD_UNLINK 5
+#define NUM_MD_OPS 6
+
+static char *md_op_names[NUM_MD_OPS] = {"create", "close", "stat", "open", "rename", "unlink"};
+
+/* the phases run one after the other, each by all threads at once */
+#define PHASE_CREATE 0
+#define PHASE_STAT 1
+#define PHASE_OPEN 2
+#define PHASE_RENAME 3
+#define PHASE_UNLINK 4
+#define NUM_PHASES 5
+
+static char *phase_names[NUM_PHASES] = {"create+close", "stat", "open+close", "rename", "unlink"};
+
+/* the phases each operation is done in, one bit per phase */
+static int md_op_phases[NUM_MD_OPS] = {1 << PHASE_CREATE, (1 << PHASE_CREATE) | (1 << PHASE_OPEN),
+                                       1 << PHASE_STAT, 1 << PHASE_OPEN, 1 << PHASE_RENAME, 1 << PHASE_UNLINK};
+
+struct md_thread {
+  pthread_t thread;
+  int id;
+  unsigned int n;
+  int shared;
+  int phase;
+  int errors;
+  struct histogram hist[NUM_MD_OPS];
+};
+
+/* Name of file i of a thread, before or after it has been renamed. */
+static void md_name(char *name, struct md_thread *t, unsigned int i, int renamed){
+
+  if(t->shared)
+    sprintf(name, "mdtest_dir/file_%d_%u%s", t->id, i, renamed ? "_r" : "");
+  else
+    sprintf(name, "mdtest_dir/thread_%d/file_%u%s", t->id, i, renamed ? "_r" : "");
+
+}
+
+static void md_record(struct md_thread *t, int op, struct timespec *start, struct timespec *end){
+
+  hist_record(&t->hist[op], time_diff(start, end));
+
+}
+
+static void *md_worker(void *arg){
+
+  struct md_thread *t = (struct md_thread *)arg;
+  struct timespec t1, t2, t3;
+  struct stat st;
+  char name[100], newname[100];
+  unsigned int i;
+  int fd;
+
+  for(i=0; i<t->n; i++){
+    md_name(name, t, i, t->phase == PHASE_UNLINK);
+
+    switch(t->phase){
+    case PHASE_CREATE:
+      clock_gettime(CLOCK, &t1);
+      fd = open(name, O_CREAT|O_EXCL|O_WRONLY, 0644);
+      clock_gettime(CLOCK, &t2);
+      if(fd < 0){
+        t->errors++;
+        break;
+      }
+      close(fd);
+      clock_gettime(CLOCK, &t3);
+      md_record(t, MD_CREATE, &t1, &t2);
+      md_record(t, MD_CLOSE, &t2, &t3);
+      break;
+
+    case PHASE_STAT:
+      clock_gettime(CLOCK, &t1);
+      if(stat(name, &st) != 0) t->errors++;
+      clock_gettime(CLOCK, &t2);
+      md_record(t, MD_STAT, &t1, &t2);
+      break;
+
+    case PHASE_OPEN:
+      clock_gettime(CLOCK, &t1);
+      fd = open(name, O_RDONLY);
+      clock_gettime(CLOCK, &t2);
+      if(fd < 0){
+        t->errors++;
+        break;
+      }
+      close(fd);
+      clock_gettime(CLOCK, &t3);
+      md_record(t, MD_OPEN, &t1, &t2);
+      md_record(t, MD_CLOSE, &t2, &t3);
+      break;
+
+    case PHASE_RENAME:
+      md_name(newname, t, i, 1);
+      clock_gettime(CLOCK, &t1);
+      if(rename(name, newname) != 0) t->errors++;
+      clock_gettime(CLOCK, &t2);
+      md_record(t, MD_RENAME, &t1, &t2);
+      break;
+
+    case PHASE_UNLINK:
+      clock_gettime(CLOCK, &t1);
+      if(unlink(name) != 0) t->errors++;
+      clock_gettime(CLOCK, &t2);
+      md_record(t, MD_UNLINK, &t1, &t2);
+      break;
+    }
+  }
+
+  return NULL;
+
+}
+
+/*
+ * Metadata scaling benchmark: T threads each create N files, stat them,
+ * open and close them, rename them and unlink them, all in one shared
+ * directory or each in a directory of its own. Every phase is timed as a
+ * whole and every operation on its own. Ops/s in the table is the number
+ * of times the operation was done over the wall time of the phases it is
+ * done in.
+ */
+int metadata_ops(unsigned int N, unsigned int T, int shared){
+
+  struct md_thread *threads;
+  struct timespec start, end;
+  char titlebuffer[500];
+  char dir[100];
+  struct histogram total;
+  double phase_time[NUM_PHASES], duration;
+  int i, op, phase, errors = 0;
+
+  if(T == 0) T = 1;
+
+  threads = calloc(T, sizeof(struct md_thread));
+  if(!threads){
+    fprintf(stderr, "ERROR: out of memory in metadata_ops\n");
+    return 1;
+  }
+
+  mkdir("mdtest_dir", 0755);
+
+  for(i=0; i<T; i++){
+    threads[i].id = i;
+    threads[i].n = N;
+    threads[i].shared = shared;
+    for(op=0; op<NUM_MD_OPS; op++){
+      hist_reset(&threads[i].hist[op], md_op_names[op]);
+    }
+    if(!shared){
+      sprintf(dir, "mdtest_dir/thread_%d", i);
+      mkdir(dir, 0755);
+    }
+  }
+
+  for(phase=0; phase<NUM_PHASES; phase++){
+    sprintf(titlebuffer, "metadata %s: %u threads x %u files, %s", phase_names[phase], T, N,
+            shared ? "shared directory" : "directory per thread");
+
+    clock_gettime(CLOCK, &start);
+
+    for(i=0; i<T; i++){
+      threads[i].phase = phase;
+      if(pthread_create(&threads[i].thread, NULL, md_worker, &threads[i]) != 0){
+        fprintf(stderr, "ERROR: unable to create thread in metadata_ops\n");
+        return 1;
+      }
+    }
+    for(i=0; i<T; i++){
+      pthread_join(threads[i].thread, NULL);
+    }
+
+    clock_gettime(CLOCK, &end);
+    phase_time[phase] = time_diff(&start, &end);
+    elapsed_time_hr(start, end, titlebuffer);
+  }
+
+  /* gather the samples of every thread for each operation */
+  sprintf(titlebuffer, "metadata: %u threads x %u files, %s", T, N,
+          shared ? "shared directory" : "directory per thread");
+  latency_header(titlebuffer);
+
+  for(op=0; op<NUM_MD_OPS; op++){
+    hist_reset(&total, md_op_names[op]);
+    for(i=0; i<T; i++){
+      hist_merge(&total, &threads[i].hist[op]);
+    }
+    duration = 0.0;
+    for(phase=0; phase<NUM_PHASES; phase++){
+      if(md_op_phases[op] & (1 << phase)) duration += phase_time[phase];
+    }
+    latency_row(md_op_names[op], &total, duration > 0 ? total.n / duration : 0.0);
+  }
+
+  latency_footer();
+
+  for(i=0; i<T; i++){
+    errors += threads[i].errors;
+    if(!shared){
+      sprintf(dir, "mdtest_dir/thread_%d", i);
+      rmdir(dir);
+    }
+  }
+  rmdir("mdtest_dir");
+
+  if(errors > 0){
+    fprintf(stderr, "ERROR: %d metadata operations failed in metadata_ops\n", errors);
+  }
+
+  free(threads);
+  fflush(stdout);
+  return errors > 0;
+}
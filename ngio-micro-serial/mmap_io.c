@@ -0,0 +1,241 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+/* need this to get MAP_POPULATE and MADV_HUGEPAGE */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "utils.h"
+#include "latency.h"
+
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+
+#define ADVICE_NONE 0
+#define ADVICE_SEQUENTIAL 1
+#define ADVICE_RANDOM 2
+#define ADVICE_WILLNEED 3
+#define ADVICE_HUGEPAGE 4
+#define NUM_ADVICE 5
+
+static char *advice_names[NUM_ADVICE] = {"none", "sequential", "random", "willneed", "hugepage"};
+
+#define MSYNC_NONE 0
+#define MSYNC_END 1
+#define MSYNC_BLOCK 2
+#define NUM_MSYNC 3
+
+static char *msync_names[NUM_MSYNC] = {"none", "end", "block"};
+
+/* apply an advice to a mapping, returns 0 if the kernel took it */
+static int mmap_advise(char *addr, size_t len, int advice){
+
+  switch(advice){
+  case ADVICE_SEQUENTIAL:
+    return madvise(addr, len, MADV_SEQUENTIAL);
+  case ADVICE_RANDOM:
+    return madvise(addr, len, MADV_RANDOM);
+  case ADVICE_WILLNEED:
+    return madvise(addr, len, MADV_WILLNEED);
+  case ADVICE_HUGEPAGE:
+#ifdef MADV_HUGEPAGE
+    return madvise(addr, len, MADV_HUGEPAGE);
+#else
+    return -1;
+#endif
+  default:
+    return 0;
+  }
+
+}
+
+/*
+ * One timed pass over the file through a fresh mapping: map (populating it
+ * if asked), advise, copy every block in or out in order or in a random
+ * order, sync as asked and unmap. Returns the duration in seconds, and the
+ * time taken to map and advise in map_time, or a negative value on error.
+ */
+static double mmap_pass(char *name, size_t len, unsigned int bs, unsigned long *order,
+                        unsigned long blocks, unsigned char *buf, int writing, int populate,
+                        int advice, int sync, int *advised, double *map_time){
+
+  struct timespec start, mapped, end;
+  long page = sysconf(_SC_PAGESIZE);
+  unsigned long i;
+  size_t offset, first;
+  char *addr;
+  int fd;
+
+  fd = open(name, writing ? O_RDWR : O_RDONLY);
+  if(fd < 0){
+    fprintf(stderr, "ERROR: unable to open test file in mmap_pass\n");
+    return -1.0;
+  }
+
+#ifdef POSIX_FADV_DONTNEED
+  /* try to start every pass from storage rather than the page cache */
+  fdatasync(fd);
+  posix_fadvise(fd, 0, len, POSIX_FADV_DONTNEED);
+#endif
+
+  clock_gettime(CLOCK, &start);
+
+  addr = mmap(NULL, len, writing ? PROT_READ|PROT_WRITE : PROT_READ,
+              MAP_SHARED | (populate ? MAP_POPULATE : 0), fd, 0);
+  if(addr == MAP_FAILED){
+    fprintf(stderr, "ERROR: unable to map test file in mmap_pass\n");
+    close(fd);
+    return -1.0;
+  }
+  *advised = mmap_advise(addr, len, advice) == 0;
+
+  clock_gettime(CLOCK, &mapped);
+
+  for(i=0; i<blocks; i++){
+    offset = (size_t)order[i] * bs;
+    if(writing){
+      memcpy(addr + offset, buf, bs);
+      if(sync == MSYNC_BLOCK){
+        first = offset - offset % page;
+        msync(addr + first, offset + bs - first, MS_SYNC);
+      }
+    }
+    else memcpy(buf, addr + offset, bs);
+  }
+
+  if(writing && sync == MSYNC_END) msync(addr, len, MS_SYNC);
+  munmap(addr, len);
+
+  clock_gettime(CLOCK, &end);
+  close(fd);
+
+  *map_time = time_diff(&start, &mapped);
+  return time_diff(&start, &end);
+
+}
+
+/*
+ * Read or write an N MB file through mmap, one bs byte block at a time in
+ * order or in a random order, for every madvise advice with and without
+ * MAP_POPULATE, and for writes every msync policy: none, one msync at the
+ * end, or an msync of each block as it is written. The time includes
+ * mapping, syncing and unmapping.
+ */
+int file_mmap(unsigned int N, unsigned int bs, int writing, int random_order){
+
+  char titlebuffer[500];
+  char *name = "testfile_1";
+  unsigned char *buf;
+  unsigned long *order;
+  unsigned long blocks, i, j, tmp;
+  size_t len;
+  double duration, map_time;
+  int fd, advice, populate, sync, advised;
+  char *op;
+
+  if(writing) op = random_order ? "file_mmap_write_random" : "file_mmap_write";
+  else op = random_order ? "file_mmap_read_random" : "file_mmap_read";
+
+  if(bs == 0){
+    fprintf(stderr, "ERROR: block size must be at least one byte in %s\n", op);
+    return 1;
+  }
+
+  len = (size_t)N << 20;
+  blocks = len / bs;
+  if(blocks == 0){
+    fprintf(stderr, "ERROR: a file of %u MB holds no %u byte blocks in %s\n", N, bs, op);
+    return 1;
+  }
+
+  buf = malloc(bs);
+  order = malloc(blocks * sizeof(unsigned long));
+  if(!buf || !order){
+    fprintf(stderr, "ERROR: out of memory in %s\n", op);
+    return 1;
+  }
+  memset(buf, 0x5a, bs);
+
+  /* visiting order of the blocks, shuffled for random access */
+  for(i=0; i<blocks; i++){
+    order[i] = i;
+  }
+  if(random_order){
+    for(i=blocks-1; i>0; i--){
+      j = rand() % (i + 1);
+      tmp = order[i];
+      order[i] = order[j];
+      order[j] = tmp;
+    }
+  }
+
+  /* create the test file */
+  fd = open(name, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+  if(fd < 0){
+    fprintf(stderr, "ERROR: unable to open test file for writing in %s\n", op);
+    return 1;
+  }
+  for(i=0; i<blocks; i++){
+    write(fd, buf, bs);
+  }
+  fsync(fd);
+  close(fd);
+  len = blocks * bs;
+
+  sprintf(titlebuffer, "%s: %lu blocks of %u bytes", op, blocks, bs);
+  printf("\n--- %s\n", titlebuffer);
+  printf("--- Timings ------------------------------------------------------------------------\n");
+  printf("|\n");
+  printf("| %-10s %8s %6s %12s %12s %12s\n", "Advice", "Populate", "msync", "Map (ms)", "Total (s)", "MB/s");
+
+  for(advice=0; advice<NUM_ADVICE; advice++){
+    for(populate=0; populate<2; populate++){
+      for(sync=0; sync<(writing ? NUM_MSYNC : 1); sync++){
+        duration = mmap_pass(name, len, bs, order, blocks, buf, writing, populate, advice,
+                             sync, &advised, &map_time);
+        if(duration < 0) return 1;
+
+        printf("| %-10s %8s %6s %12.3f %12.6f %12.2f%s\n", advice_names[advice], populate ? "yes" : "no",
+               writing ? msync_names[sync] : "-", 1e3*map_time, duration, len / duration / 1e6,
+               advised ? "" : "   (advice refused)");
+      }
+    }
+  }
+
+  printf("|\n");
+  printf("------------------------------------------------------------------------------------\n");
+
+  unlink(name);
+  free(order);
+  free(buf);
+  fflush(stdout);
+
+  return 0;
+}
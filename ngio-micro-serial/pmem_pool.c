@@ -0,0 +1,358 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+#ifdef PMEM
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <libpmem.h>
+
+#include "utils.h"
+#include "latency.h"
+
+/*
+ * A small-object store carved out of one mapped pmem pool by a slab
+ * allocator. Objects are rounded up to a power of two size class (64 bytes
+ * at least). Each class takes slabs of POOL_SLAB bytes, or one object if it
+ * is bigger, from the end of the used part of the pool. A slab starts with
+ * a page holding its class and an allocation bitmap. Storing an object
+ * persists its data, then sets and persists its bit, so a crash never
+ * leaves an allocated object that was not written. The pool and slab
+ * headers are persistent; which slab each class is filling is kept in DRAM.
+ */
+
+#define POOL_MAGIC 0x4e47494f504f4f4cULL
+#define POOL_SLAB (1UL << 20)
+#define POOL_MIN_CLASS 6
+#define POOL_CLASSES 48
+#define SLAB_HEADER 4096
+#define SLAB_BITMAP_WORDS ((SLAB_HEADER - 2*sizeof(uint64_t)) / sizeof(uint64_t))
+
+struct pool_header {
+  uint64_t magic;
+  uint64_t size;
+  uint64_t used;
+};
+
+struct slab_header {
+  uint64_t class_size;
+  uint64_t objects;
+  uint64_t bitmap[SLAB_BITMAP_WORDS];
+};
+
+struct pool {
+  char *base;
+  size_t len;
+  int is_pmem;
+  struct pool_header *header;
+  struct slab_header *current[POOL_CLASSES];
+  uint64_t hint[POOL_CLASSES];
+};
+
+static void pool_persist(struct pool *p, void *addr, size_t len){
+
+  if(p->is_pmem) pmem_persist(addr, len);
+  else pmem_msync(addr, len);
+
+}
+
+static int size_class(size_t size){
+
+  int c = POOL_MIN_CLASS;
+
+  while(((size_t)1 << c) < size) c++;
+  return c;
+
+}
+
+static size_t slab_bytes(size_t object){
+
+  return SLAB_HEADER + (object > POOL_SLAB ? object : POOL_SLAB);
+
+}
+
+/* The next slab of class c after slab, or NULL if there is none. */
+static struct slab_header *pool_next_slab(struct pool *p, int c, struct slab_header *slab){
+
+  char *at = slab ? (char *)slab + slab_bytes(slab->class_size) : p->base + SLAB_HEADER;
+
+  while(at < p->base + p->header->used){
+    slab = (struct slab_header *)at;
+    if(slab->class_size == ((size_t)1 << c)) return slab;
+    at += slab_bytes(slab->class_size);
+  }
+
+  return NULL;
+
+}
+
+/* Carve a new slab for class c from the unused end of the pool. */
+static struct slab_header *pool_new_slab(struct pool *p, int c){
+
+  size_t object = (size_t)1 << c;
+  size_t bytes = slab_bytes(object) - SLAB_HEADER;
+  struct slab_header *slab;
+
+  if(p->header->used + SLAB_HEADER + bytes > p->len) return NULL;
+
+  slab = (struct slab_header *)(p->base + p->header->used);
+  memset(slab, 0, sizeof(struct slab_header));
+  slab->class_size = object;
+  slab->objects = bytes / object;
+  if(slab->objects > 64 * SLAB_BITMAP_WORDS) slab->objects = 64 * SLAB_BITMAP_WORDS;
+  pool_persist(p, slab, sizeof(struct slab_header));
+
+  /* the slab is only part of the pool once used covers it */
+  p->header->used += SLAB_HEADER + bytes;
+  pool_persist(p, &p->header->used, sizeof(uint64_t));
+
+  p->current[c] = slab;
+  p->hint[c] = 0;
+
+  return slab;
+
+}
+
+/*
+ * Store an object of size bytes: find it a free slot, copy and persist
+ * the data, then mark the slot allocated. Returns the object or NULL if the
+ * pool is full. The time spent persisting is returned in persist_time.
+ */
+static void *pool_store(struct pool *p, unsigned char *data, size_t size, double *persist_time){
+
+  int c = size_class(size);
+  struct slab_header *slab = p->current[c];
+  struct timespec t1, t2, t3, t4;
+  uint64_t i, word, bit;
+  char *object;
+
+  for(;;){
+    if(!slab && !(slab = pool_new_slab(p, c))) return NULL;
+    for(i=p->hint[c]; i<slab->objects; i++){
+      if(!(slab->bitmap[i/64] & (1ULL << (i%64)))) break;
+    }
+    if(i < slab->objects) break;
+
+    /* this slab is full, move on to the next one of the class */
+    slab = pool_next_slab(p, c, slab);
+    p->current[c] = slab;
+    p->hint[c] = 0;
+  }
+  p->hint[c] = i + 1;
+
+  object = (char *)slab + SLAB_HEADER + i * slab->class_size;
+  word = i / 64;
+  bit = 1ULL << (i % 64);
+
+  if(p->is_pmem){
+    pmem_memcpy_nodrain(object, data, size);
+    clock_gettime(CLOCK, &t1);
+    pmem_drain();
+    clock_gettime(CLOCK, &t2);
+  }
+  else{
+    memcpy(object, data, size);
+    clock_gettime(CLOCK, &t1);
+    pmem_msync(object, size);
+    clock_gettime(CLOCK, &t2);
+  }
+
+  slab->bitmap[word] |= bit;
+  clock_gettime(CLOCK, &t3);
+  pool_persist(p, &slab->bitmap[word], sizeof(uint64_t));
+  clock_gettime(CLOCK, &t4);
+
+  *persist_time = time_diff(&t1, &t2) + time_diff(&t3, &t4);
+
+  return object;
+
+}
+
+/* Free every object of a size class, one persisted bitmap word at a time. */
+static void pool_free_class(struct pool *p, size_t size){
+
+  int c = size_class(size);
+  struct slab_header *slab = NULL;
+  uint64_t w;
+
+  while((slab = pool_next_slab(p, c, slab)) != NULL){
+    for(w=0; w<(slab->objects + 63)/64; w++){
+      if(slab->bitmap[w] == 0) continue;
+      slab->bitmap[w] = 0;
+      pool_persist(p, &slab->bitmap[w], sizeof(uint64_t));
+    }
+  }
+
+  /* start filling the first slab of the class again */
+  p->current[c] = pool_next_slab(p, c, NULL);
+  p->hint[c] = 0;
+
+}
+
+static int pool_open(struct pool *p, char *name, size_t len){
+
+  memset(p, 0, sizeof(struct pool));
+
+  p->base = pmem_map_file(name, len, PMEM_FILE_CREATE, 0644, &p->len, &p->is_pmem);
+  if(p->base == NULL) return 1;
+
+  /* the pool header has a page to itself */
+  p->header = (struct pool_header *)p->base;
+  p->header->magic = POOL_MAGIC;
+  p->header->size = p->len;
+  p->header->used = SLAB_HEADER;
+  pool_persist(p, p->header, sizeof(struct pool_header));
+
+  return 0;
+
+}
+
+/*
+ * Store N objects of size bytes as the sweep of pmem_file_write does, once
+ * as a file per object (map, copy, drain, unmap) and once as objects in a
+ * pool, and compare the rates and latencies of the two. For the pool the
+ * latency of the persists of data and metadata is shown on its own too,
+ * with its rate over the same wall time as the pool's stores.
+ */
+int pmem_pool_write(unsigned int N, char *nvmelocation){
+
+  struct pool p;
+  struct histogram file_hist, pool_hist, persist_hist;
+  struct timespec start, end, t1, t2;
+  char name[600], poolname[600];
+  char titlebuffer[500];
+  unsigned char *data;
+  char *pmemaddr;
+  size_t mapped_len, pool_len;
+  double persist_time, file_duration, pool_duration;
+  unsigned int n, steps;
+  int size = 1;
+  int i, j, fd, reps, is_pmem;
+
+  /* allocate and initialise data */
+  data = malloc(N);
+  if(!data){
+    fprintf(stderr, "ERROR: out of memory in pmem_pool_write\n");
+    return 1;
+  }
+  fd = open("/dev/urandom", O_RDONLY);
+  if(fd < 0){
+    fprintf(stderr, "ERROR: unable to open /dev/urandom in pmem_pool_write\n");
+    return 1;
+  }
+  read(fd, data, N);
+  close(fd);
+
+  /* don't overload the system by doing too many tiny files */
+  while(N >= 10000){
+    N = N / 2;
+    size = size * 2;
+  }
+
+  /* each step fills at most twice its bytes plus a partly used slab */
+  for(n=N, steps=0; n>=1; n/=2) steps++;
+  pool_len = SLAB_HEADER + steps * (2 * (size_t)N * size + (size_t)N * SLAB_HEADER + 2 * POOL_SLAB);
+
+  sprintf(poolname, "%s/pool", nvmelocation);
+  if(pool_open(&p, poolname, pool_len) != 0){
+    perror("ERROR: unable to create the pool in pmem_pool_write");
+    return 1;
+  }
+
+  while(N >= 1){
+    reps = 128 / N;
+    if(reps == 0) reps = 1;
+
+    /* a file per object */
+    hist_reset(&file_hist, "file");
+    clock_gettime(CLOCK, &start);
+    for(j=0; j<reps; j++){
+      for(i=0; i<N; i++){
+        sprintf(name, "%s/testfile_%d", nvmelocation, i);
+        clock_gettime(CLOCK, &t1);
+        if((pmemaddr = pmem_map_file(name, size, PMEM_FILE_CREATE, 0644, &mapped_len, &is_pmem)) == NULL){
+          perror("ERROR: unable to open test file for writing in pmem_pool_write");
+          return 1;
+        }
+        pmem_memcpy_nodrain(pmemaddr, data, size);
+        pmem_drain();
+        pmem_unmap(pmemaddr, mapped_len);
+        clock_gettime(CLOCK, &t2);
+        hist_record(&file_hist, time_diff(&t1, &t2));
+      }
+    }
+    clock_gettime(CLOCK, &end);
+    file_duration = time_diff(&start, &end);
+
+    for(i=0; i<N; i++){
+      sprintf(name, "%s/testfile_%d", nvmelocation, i);
+      unlink(name);
+    }
+
+    /* objects in the pool, freed after each repetition */
+    hist_reset(&pool_hist, "pool");
+    hist_reset(&persist_hist, "persist");
+    pool_duration = 0.0;
+    for(j=0; j<reps; j++){
+      clock_gettime(CLOCK, &start);
+      for(i=0; i<N; i++){
+        clock_gettime(CLOCK, &t1);
+        if(pool_store(&p, data, size, &persist_time) == NULL){
+          fprintf(stderr, "ERROR: pool is full in pmem_pool_write\n");
+          return 1;
+        }
+        clock_gettime(CLOCK, &t2);
+        hist_record(&pool_hist, time_diff(&t1, &t2));
+        hist_record(&persist_hist, persist_time);
+      }
+      clock_gettime(CLOCK, &end);
+      pool_duration += time_diff(&start, &end);
+      pool_free_class(&p, size);
+    }
+
+    sprintf(titlebuffer, "pmem_pool_write: %d objects of %d bytes, %s", N, size,
+            p.is_pmem ? "pmem" : "not pmem, msync");
+    latency_header(titlebuffer);
+    latency_row("file", &file_hist, file_hist.n / file_duration);
+    latency_row("pool", &pool_hist, pool_hist.n / pool_duration);
+    latency_row("persist", &persist_hist, persist_hist.n / pool_duration);
+    printf("|\n");
+    printf("| Pool speedup over file per object: %.1fx\n", (pool_hist.n / pool_duration) / (file_hist.n / file_duration));
+    latency_footer();
+
+    /* halve number of objects but double their size */
+    N = N / 2;
+    size = size * 2;
+  }
+
+  pmem_unmap(p.base, p.len);
+  unlink(poolname);
+  free(data);
+  fflush(stdout);
+
+  return 0;
+}
+
+#endif
@@ -0,0 +1,262 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+/* need this to get fallocate and FALLOC_FL_KEEP_SIZE */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "utils.h"
+#include "latency.h"
+
+/*
+ * How a file gets its blocks before it is written:
+ *
+ *   extend      created with O_TRUNC and extended by each write, as the
+ *               file_write benchmarks do.
+ *   posix_fallocate, fallocate
+ *               all blocks allocated up front. glibc emulates
+ *               posix_fallocate by writing to every block where the
+ *               filesystem has no fallocate.
+ *   keep_size   fallocate with FALLOC_FL_KEEP_SIZE: the blocks are
+ *               allocated but each write still grows the file size.
+ *   sparse      ftruncate to the full size, writes fill the hole.
+ *   overwrite   an existing, fully written and synced file is rewritten.
+ */
+#define PREALLOC_EXTEND 0
+#define PREALLOC_POSIX 1
+#define PREALLOC_FALLOCATE 2
+#define PREALLOC_KEEP_SIZE 3
+#define PREALLOC_SPARSE 4
+#define PREALLOC_OVERWRITE 5
+#define NUM_PREALLOC 6
+
+static char *prealloc_names[NUM_PREALLOC] = {"extend", "posix_fallocate", "fallocate", "keep_size", "sparse", "overwrite"};
+
+/* each sync call once before close, and after every block */
+#define SYNC_NONE 0
+#define SYNC_FSYNC_END 1
+#define SYNC_FDATASYNC_END 2
+#define SYNC_FSYNC_BLOCK 3
+#define SYNC_FDATASYNC_BLOCK 4
+#define NUM_SYNC 5
+
+static char *sync_names[NUM_SYNC] = {"none", "fsync_end", "fdatasync_end", "fsync_block", "fdatasync_block"};
+
+/* most files written for one file size, so small files don't take forever */
+#define PREALLOC_MAX_FILES 256
+
+/* give fd its blocks as method says, returns 0, or an errno value */
+static int prealloc_file(int fd, off_t size, int method){
+
+  switch(method){
+  case PREALLOC_POSIX:
+    return posix_fallocate(fd, 0, size);
+#ifdef __linux__
+  case PREALLOC_FALLOCATE:
+    return fallocate(fd, 0, 0, size) == 0 ? 0 : errno;
+#ifdef FALLOC_FL_KEEP_SIZE
+  case PREALLOC_KEEP_SIZE:
+    return fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size) == 0 ? 0 : errno;
+#endif
+#endif
+  case PREALLOC_SPARSE:
+    return ftruncate(fd, size) == 0 ? 0 : errno;
+  case PREALLOC_EXTEND:
+  case PREALLOC_OVERWRITE:
+    return 0;
+  default:
+    return EOPNOTSUPP;
+  }
+
+}
+
+/*
+ * Write files files of size bytes in bs byte blocks, preparing each as
+ * method says and syncing as sync says: not at all, or with fsync or
+ * fdatasync either once before close or after every block. Returns the duration in seconds and
+ * the part of it spent allocating in alloc_time, or a negative value if
+ * the method is not supported (-2) or on error (-1).
+ */
+static double prealloc_pass(unsigned int files, size_t size, unsigned int bs, unsigned char *buf,
+                            int method, int sync, double *alloc_time){
+
+  struct timespec start, end, t1, t2;
+  char name[100];
+  size_t blocks = size / bs;
+  size_t j;
+  unsigned int i;
+  int fd, err;
+
+  /* start from no files, or from fully written ones to overwrite */
+  for(i=0; i<files; i++){
+    sprintf(name, "testfile_%u", i);
+    unlink(name);
+    if(method != PREALLOC_OVERWRITE) continue;
+
+    fd = open(name, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+    if(fd < 0){
+      fprintf(stderr, "ERROR: unable to open test file for writing in prealloc_pass\n");
+      return -1.0;
+    }
+    for(j=0; j<blocks; j++){
+      write(fd, buf, bs);
+    }
+    fsync(fd);
+    close(fd);
+  }
+
+  *alloc_time = 0.0;
+  clock_gettime(CLOCK, &start);
+
+  for(i=0; i<files; i++){
+    sprintf(name, "testfile_%u", i);
+    fd = open(name, O_CREAT|O_WRONLY|(method == PREALLOC_OVERWRITE ? 0 : O_TRUNC), 0644);
+    if(fd < 0){
+      fprintf(stderr, "ERROR: unable to open test file for writing in prealloc_pass\n");
+      return -1.0;
+    }
+
+    clock_gettime(CLOCK, &t1);
+    err = prealloc_file(fd, size, method);
+    clock_gettime(CLOCK, &t2);
+    if(err != 0){
+      close(fd);
+      if(err == EOPNOTSUPP || err == ENOSYS || err == EINVAL) return -2.0;
+      fprintf(stderr, "ERROR: %s failed in prealloc_pass: %s\n", prealloc_names[method], strerror(err));
+      return -1.0;
+    }
+    *alloc_time += time_diff(&t1, &t2);
+
+    for(j=0; j<blocks; j++){
+      if(write(fd, buf, bs) != (ssize_t)bs){
+        fprintf(stderr, "ERROR: short write in prealloc_pass\n");
+        close(fd);
+        return -1.0;
+      }
+      if(sync == SYNC_FSYNC_BLOCK) fsync(fd);
+      if(sync == SYNC_FDATASYNC_BLOCK) fdatasync(fd);
+    }
+
+    if(sync == SYNC_FSYNC_END) fsync(fd);
+    if(sync == SYNC_FDATASYNC_END) fdatasync(fd);
+    close(fd);
+  }
+
+  clock_gettime(CLOCK, &end);
+
+  return time_diff(&start, &end);
+
+}
+
+/*
+ * Compare writing files that are extended block by block with files that
+ * are preallocated, sparse, or already written, with and without syncing.
+ * File sizes go from 64 KB up to N MB by factors of 16, writing N MB in
+ * bs byte blocks for each size, over up to PREALLOC_MAX_FILES files.
+ */
+int file_prealloc(unsigned int N, unsigned int bs){
+
+  size_t total = (size_t)N << 20;
+  size_t size, last = 0;
+  unsigned char *buf;
+  unsigned int i, files;
+  double duration, alloc_time, base[NUM_SYNC];
+  char name[100];
+  int method, sync, fd, done = 0;
+
+  if(bs == 0 || total < bs){
+    fprintf(stderr, "ERROR: file_write_prealloc needs a size of at least one %u byte block\n", bs);
+    return 1;
+  }
+
+  buf = malloc(bs);
+  if(!buf){
+    fprintf(stderr, "ERROR: out of memory in file_write_prealloc\n");
+    return 1;
+  }
+  fd = open("/dev/urandom", O_RDONLY);
+  if(fd < 0){
+    fprintf(stderr, "ERROR: unable to open /dev/urandom in file_write_prealloc\n");
+    return 1;
+  }
+  read(fd, buf, bs);
+  close(fd);
+
+  size = bs > (64 << 10) ? bs : 64 << 10;
+  while(!done){
+    /* finish with the full size, whether or not the steps hit it */
+    if(size >= total){
+      size = total;
+      done = 1;
+    }
+    size -= size % bs;
+    if(size == last){
+      size *= 16;
+      continue;
+    }
+    last = size;
+
+    files = total / size;
+    if(files > PREALLOC_MAX_FILES) files = PREALLOC_MAX_FILES;
+
+    printf("\n--- file_write_prealloc: %u files of %zu bytes in %u byte blocks\n", files, size, bs);
+    printf("--- Timings ------------------------------------------------------------------------\n");
+    printf("|\n");
+    printf("| %-16s %16s %12s %12s %12s %10s\n", "Method", "Sync", "Alloc (ms)", "Total (s)", "MB/s", "vs extend");
+
+    for(method=0; method<NUM_PREALLOC; method++){
+      for(sync=0; sync<NUM_SYNC; sync++){
+        duration = prealloc_pass(files, size, bs, buf, method, sync, &alloc_time);
+        if(duration == -2.0){
+          printf("| %-16s %16s %12s\n", prealloc_names[method], sync_names[sync], "not supported");
+          continue;
+        }
+        if(duration < 0) return 1;
+        if(method == PREALLOC_EXTEND) base[sync] = duration;
+
+        printf("| %-16s %16s %12.3f %12.6f %12.2f %9.2fx\n", prealloc_names[method], sync_names[sync],
+               1e3*alloc_time, duration, (double)files * size / duration / 1e6, base[sync] / duration);
+      }
+    }
+
+    printf("|\n");
+    printf("------------------------------------------------------------------------------------\n");
+
+    size *= 16;
+  }
+
+  for(i=0; i<PREALLOC_MAX_FILES; i++){
+    sprintf(name, "testfile_%u", i);
+    unlink(name);
+  }
+  free(buf);
+  fflush(stdout);
+
+  return 0;
+}
@@ -6,6 +6,7 @@ nvme_location=/media/nvme1
  ./micro -b io -s ${size} -o mk_rm_dir
  ./micro -b io -s ${size} -o file_write
  ./micro -b io -s ${size} -o file_pmem_write -l ${nvme_location}
+ ./micro -b io -s ${size} -o pmem_pool_write -l ${nvme_location}
  ./micro -b io -s ${size} -o file_read
  ./micro -b io -s ${size} -o file_pmem_read -l ${nvme_location}
  ./micro -b io -s ${size} -o file_write_random
@@ -14,3 +15,21 @@ nvme_location=/media/nvme1
  ./micro -b io -s ${size} -o file_pmem_read_random -l ${nvme_location}
  ./micro -b io -s ${size} -o file_read_direct
  ./micro -b io -s ${size} -o file_read_random_direct
+ ./micro -b io -s ${size} -K 8 -o file_write_random_compare
+ ./micro -b io -s ${size} -K 8 -o file_read_random_compare
+ ./micro -b io -s 10000 -T 4 -o metadata_shared
+ ./micro -b io -s 10000 -T 4 -o metadata_private
+ ./micro -b io -s 1024 -n 4 -k 4096 -o aio_read_random
+ ./micro -b io -s 1024 -n 4 -k 4096 -o aio_write_random
+ ./micro -b io -s 1024 -k 4096 -o file_mmap_read
+ ./micro -b io -s 1024 -k 4096 -o file_mmap_read_random
+ ./micro -b io -s 1024 -k 4096 -o file_mmap_write
+ ./micro -b io -s 1024 -k 4096 -o file_mmap_write_random
+ ./micro -b io -s 10000 -T 8 -o wal_fsync
+ ./micro -b io -s 10000 -T 8 -K 8 -w 1000 -o wal_group
+ ./micro -b io -s 10000 -T 8 -o wal_pmem -l ${nvme_location}
+ ./micro -b io -s 64 -k 4096 -o file_write_prealloc
+ ./micro -b io -s 1024 -o file_read_direct_sweep
+ ./micro -b io -s 1024 -o file_write_direct_sweep
+ ./micro -b io -s 1024 -o file_copy -c ${nvme_location}
+ ./micro -b io -o job -j example.job
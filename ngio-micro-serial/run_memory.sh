@@ -9,9 +9,16 @@ nvme_location=/media/nvme1
  ./micro -b memory -s ${size} -o read_vram -l ${nvme_location}
  ./micro -b memory -s ${size} -o read_lat
  ./micro -b memory -s ${size} -o vmem_read_lat -l ${nvme_location}
+ ./micro -b memory -s 4096 -o read_lat_sweep
+ ./micro -b memory -s 4096 -o read_lat_sweep -P
+ ./micro -b memory -s 4096 -o read_vmem_lat_sweep -l ${nvme_location}
  ./micro -b memory -s ${size} -o write_contig
  ./micro -b memory -s ${size} -o write_vmem_contig -l ${nvme_location}
  ./micro -b memory -s ${size} -o write_strided
  ./micro -b memory -s ${size} -o write_vmem_strided -l ${nvme_location}
  ./micro -b memory -s ${size} -o write_random
  ./micro -b memory -s ${size} -o write_vmem_random -l ${nvme_location}
+ ./micro -b memory -s 1024 -T 8 -o read_bw
+ ./micro -b memory -s 1024 -T 8 -o read_vmem_bw -l ${nvme_location}
+ ./micro -b memory -s 1024 -T 8 -o write_bw
+ ./micro -b memory -s 1024 -T 8 -o write_vmem_bw -l ${nvme_location}
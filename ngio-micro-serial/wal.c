@@ -0,0 +1,427 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* Licensed under the Apache License, Version 2.0 (the "License"); */
+/* you may not use this file except in compliance with the License. */
+/* You may obtain a copy of the License at */
+
+/*     http://www.apache.org/licenses/LICENSE-2.0 */
+
+/* Unless required by applicable law or agreed to in writing, software */
+/* distributed under the License is distributed on an "AS IS" BASIS, */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. */
+/* See the License for the specific language governing permissions and */
+/* limitations under the License. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "latency.h"
+
+#ifdef PMEM
+#include<libpmem.h>
+#endif
+
+/*
+ * Write-ahead log benchmark: T writer threads each append N records of a
+ * random size to one log and wait for every record to be durable (its
+ * commit) before appending the next. A record is a header holding its
+ * length and sequence number, followed by the payload. The commit policies:
+ *
+ *   WAL_FSYNC  each writer appends its record with pwrite at the tail and
+ *              calls fdatasync itself.
+ *   WAL_GROUP  writers copy records into a shared buffer and sleep; a
+ *              flusher thread writes the buffer and calls fdatasync once
+ *              `batch` records are waiting or the oldest has waited
+ *              `timeout` microseconds, then wakes the writers it covered.
+ *   WAL_PMEM   the log is a pmem mapping; each writer reserves space at
+ *              the tail, persists the payload and then the header, so a
+ *              header is never durable before its record.
+ */
+
+#define WAL_FSYNC 0
+#define WAL_GROUP 1
+#define WAL_PMEM 2
+
+static char *wal_policy_names[] = {"wal_fsync", "wal_group", "wal_pmem"};
+
+/* smallest record payload */
+#define WAL_MIN_RECORD 16
+
+struct wal_record_header {
+  uint32_t length;
+  uint32_t thread;
+  uint64_t sequence;
+};
+
+struct wal {
+  int policy;
+  int fd;
+  char *pmem_base;
+  size_t pmem_len;
+  int is_pmem;
+  unsigned int max_record;
+  unsigned int batch;
+  unsigned int timeout;
+
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t durable;
+  unsigned long long tail;
+  unsigned long long appended;
+  unsigned long long durable_seq;
+  int writers_left;
+
+  /* group commit buffers, filled while the other is flushed */
+  char *buffer;
+  size_t used;
+  size_t capacity;
+  char *flushing;
+  size_t flushing_capacity;
+  struct timespec oldest;
+
+  struct histogram flush;
+  unsigned long flushes;
+};
+
+struct wal_writer {
+  pthread_t thread;
+  struct wal *log;
+  int id;
+  unsigned int records;
+  unsigned long long bytes;
+  struct histogram commit;
+  int errors;
+};
+
+/* Block until the record just appended with sequence seq is durable. */
+static void wal_wait(struct wal *w, unsigned long long seq){
+
+  while(w->durable_seq < seq){
+    pthread_cond_wait(&w->durable, &w->lock);
+  }
+
+}
+
+static int wal_append(struct wal_writer *wr, char *record, size_t len){
+
+  struct wal *w = wr->log;
+  struct wal_record_header *h = (struct wal_record_header *)record;
+  unsigned long long offset, seq;
+  char *grown;
+
+  switch(w->policy){
+  case WAL_FSYNC:
+    pthread_mutex_lock(&w->lock);
+    offset = w->tail;
+    w->tail += len;
+    h->sequence = ++w->appended;
+    pthread_mutex_unlock(&w->lock);
+
+    if(pwrite(w->fd, record, len, offset) != (ssize_t)len) return 1;
+    return fdatasync(w->fd);
+
+  case WAL_GROUP:
+    pthread_mutex_lock(&w->lock);
+    if(w->used + len > w->capacity){
+      grown = realloc(w->buffer, 2 * (w->used + len));
+      if(!grown){
+        pthread_mutex_unlock(&w->lock);
+        return 1;
+      }
+      w->buffer = grown;
+      w->capacity = 2 * (w->used + len);
+    }
+    seq = h->sequence = ++w->appended;
+    memcpy(w->buffer + w->used, record, len);
+    if(w->used == 0) clock_gettime(CLOCK, &w->oldest);
+    w->used += len;
+    pthread_cond_signal(&w->work);
+    wal_wait(w, seq);
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+
+#ifdef PMEM
+  case WAL_PMEM:
+    offset = __sync_fetch_and_add(&w->tail, len);
+    if(offset + len > w->pmem_len) return 1;
+    h->sequence = __sync_add_and_fetch(&w->appended, 1);
+
+    /* payload first, then the header that makes it part of the log */
+    if(w->is_pmem){
+      pmem_memcpy_persist(w->pmem_base + offset + sizeof(*h), record + sizeof(*h), len - sizeof(*h));
+      pmem_memcpy_persist(w->pmem_base + offset, record, sizeof(*h));
+    }
+    else{
+      memcpy(w->pmem_base + offset + sizeof(*h), record + sizeof(*h), len - sizeof(*h));
+      pmem_msync(w->pmem_base + offset + sizeof(*h), len - sizeof(*h));
+      memcpy(w->pmem_base + offset, record, sizeof(*h));
+      pmem_msync(w->pmem_base + offset, sizeof(*h));
+    }
+    return 0;
+#endif
+  }
+
+  return 1;
+
+}
+
+static void *wal_writer_thread(void *arg){
+
+  struct wal_writer *wr = (struct wal_writer *)arg;
+  struct wal *w = wr->log;
+  struct wal_record_header *h;
+  struct timespec t1, t2;
+  unsigned int seed = 1234 + wr->id;
+  unsigned int i;
+  size_t payload;
+  char *record;
+
+  record = malloc(sizeof(struct wal_record_header) + w->max_record);
+  if(!record){
+    wr->errors++;
+    return NULL;
+  }
+  memset(record, 'a' + wr->id % 26, sizeof(struct wal_record_header) + w->max_record);
+  h = (struct wal_record_header *)record;
+
+  for(i=0; i<wr->records; i++){
+    payload = WAL_MIN_RECORD + rand_r(&seed) % (w->max_record - WAL_MIN_RECORD + 1);
+    h->length = payload;
+    h->thread = wr->id;
+
+    clock_gettime(CLOCK, &t1);
+    if(wal_append(wr, record, sizeof(*h) + payload) != 0) wr->errors++;
+    clock_gettime(CLOCK, &t2);
+
+    hist_record(&wr->commit, time_diff(&t1, &t2));
+    wr->bytes += sizeof(*h) + payload;
+  }
+
+  if(w->policy == WAL_GROUP){
+    pthread_mutex_lock(&w->lock);
+    w->writers_left--;
+    pthread_cond_signal(&w->work);
+    pthread_mutex_unlock(&w->lock);
+  }
+
+  free(record);
+  return NULL;
+
+}
+
+/* The group commit flusher, runs until the last writer has finished. */
+static void *wal_flusher_thread(void *arg){
+
+  struct wal *w = (struct wal *)arg;
+  struct timespec now, wake, t1, t2;
+  unsigned long long covered;
+  long long left;
+  size_t len, capacity;
+  char *full;
+
+  pthread_mutex_lock(&w->lock);
+
+  for(;;){
+    /* wait for a batch, the oldest record's timeout, or the end */
+    while(w->writers_left > 0 && w->appended - w->durable_seq < w->batch){
+      if(w->used == 0){
+        pthread_cond_wait(&w->work, &w->lock);
+        continue;
+      }
+      clock_gettime(CLOCK, &now);
+      left = (long long)w->timeout * 1000 - (long long)(1e9 * time_diff(&w->oldest, &now));
+      if(left <= 0) break;
+
+      /* the condition variable times out on CLOCK_REALTIME */
+      clock_gettime(CLOCK_REALTIME, &wake);
+      wake.tv_sec += (wake.tv_nsec + left) / 1000000000;
+      wake.tv_nsec = (wake.tv_nsec + left) % 1000000000;
+      pthread_cond_timedwait(&w->work, &w->lock, &wake);
+    }
+
+    if(w->used == 0){
+      if(w->writers_left == 0) break;
+      continue;
+    }
+
+    /* take the filled buffer and let writers carry on filling the other */
+    full = w->buffer;
+    capacity = w->capacity;
+    len = w->used;
+    covered = w->appended;
+    w->buffer = w->flushing;
+    w->capacity = w->flushing_capacity;
+    w->flushing = full;
+    w->flushing_capacity = capacity;
+    w->used = 0;
+    pthread_mutex_unlock(&w->lock);
+
+    clock_gettime(CLOCK, &t1);
+    pwrite(w->fd, full, len, w->tail);
+    fdatasync(w->fd);
+    clock_gettime(CLOCK, &t2);
+
+    pthread_mutex_lock(&w->lock);
+    w->tail += len;
+    hist_record(&w->flush, time_diff(&t1, &t2));
+    w->flushes++;
+    w->durable_seq = covered;
+    pthread_cond_broadcast(&w->durable);
+  }
+
+  pthread_mutex_unlock(&w->lock);
+  return NULL;
+
+}
+
+/*
+ * Run T writers appending N records each, of WAL_MIN_RECORD to max_record
+ * payload bytes, to a log in dir under a commit policy, and report the
+ * commit latency percentiles and records per second.
+ */
+int wal_bench(unsigned int N, unsigned int T, unsigned int max_record, unsigned int batch,
+              unsigned int timeout, int policy, char *dir){
+
+  struct wal w;
+  struct wal_writer *writers;
+  struct histogram total;
+  struct timespec start, end;
+  pthread_t flusher;
+  char name[600];
+  char titlebuffer[500];
+  unsigned long long bytes = 0;
+  double duration;
+  int i, errors = 0;
+
+  if(T == 0) T = 1;
+  if(batch == 0) batch = 1;
+  if(max_record < WAL_MIN_RECORD) max_record = WAL_MIN_RECORD;
+
+  memset(&w, 0, sizeof(w));
+  w.policy = policy;
+  w.max_record = max_record;
+  w.batch = batch;
+  w.timeout = timeout;
+  w.writers_left = T;
+  pthread_mutex_init(&w.lock, NULL);
+  pthread_cond_init(&w.work, NULL);
+  pthread_cond_init(&w.durable, NULL);
+  hist_reset(&w.flush, "flush");
+
+  sprintf(name, "%s/wal_log", dir);
+
+  if(policy == WAL_PMEM){
+#ifdef PMEM
+    w.pmem_base = pmem_map_file(name, (size_t)T * N * (sizeof(struct wal_record_header) + max_record),
+                                PMEM_FILE_CREATE, 0644, &w.pmem_len, &w.is_pmem);
+    if(w.pmem_base == NULL){
+      perror("ERROR: unable to map the log in wal_bench");
+      return 1;
+    }
+#endif
+  }
+  else{
+    w.fd = open(name, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+    if(w.fd < 0){
+      fprintf(stderr, "ERROR: unable to open the log in wal_bench\n");
+      return 1;
+    }
+  }
+
+  if(policy == WAL_GROUP){
+    w.capacity = (size_t)batch * (sizeof(struct wal_record_header) + max_record);
+    w.flushing_capacity = w.capacity;
+    w.buffer = malloc(w.capacity);
+    w.flushing = malloc(w.flushing_capacity);
+    if(!w.buffer || !w.flushing){
+      fprintf(stderr, "ERROR: out of memory in wal_bench\n");
+      return 1;
+    }
+  }
+
+  writers = calloc(T, sizeof(struct wal_writer));
+  if(!writers){
+    fprintf(stderr, "ERROR: out of memory in wal_bench\n");
+    return 1;
+  }
+
+  if(policy == WAL_GROUP)
+    sprintf(titlebuffer, "%s: %u threads x %u records of %d-%u bytes, batch %u, timeout %u us",
+            wal_policy_names[policy], T, N, WAL_MIN_RECORD, max_record, batch, timeout);
+  else
+    sprintf(titlebuffer, "%s: %u threads x %u records of %d-%u bytes",
+            wal_policy_names[policy], T, N, WAL_MIN_RECORD, max_record);
+
+  clock_gettime(CLOCK, &start);
+
+  if(policy == WAL_GROUP && pthread_create(&flusher, NULL, wal_flusher_thread, &w) != 0){
+    fprintf(stderr, "ERROR: unable to create thread in wal_bench\n");
+    return 1;
+  }
+  for(i=0; i<T; i++){
+    writers[i].log = &w;
+    writers[i].id = i;
+    writers[i].records = N;
+    hist_reset(&writers[i].commit, "commit");
+    if(pthread_create(&writers[i].thread, NULL, wal_writer_thread, &writers[i]) != 0){
+      fprintf(stderr, "ERROR: unable to create thread in wal_bench\n");
+      return 1;
+    }
+  }
+  for(i=0; i<T; i++){
+    pthread_join(writers[i].thread, NULL);
+  }
+  if(policy == WAL_GROUP) pthread_join(flusher, NULL);
+
+  clock_gettime(CLOCK, &end);
+  duration = elapsed_time_hr(start, end, titlebuffer);
+
+  hist_reset(&total, "commit");
+  for(i=0; i<T; i++){
+    hist_merge(&total, &writers[i].commit);
+    bytes += writers[i].bytes;
+    errors += writers[i].errors;
+  }
+
+  latency_header(titlebuffer);
+  latency_row("commit", &total, total.n / duration);
+  if(policy == WAL_GROUP) latency_row("flush", &w.flush, w.flushes / duration);
+  printf("|\n");
+  printf("| Records/s: %.0f   Throughput: %.3f MB/s", total.n / duration, bytes / duration / 1e6);
+  if(policy == WAL_GROUP) printf("   Records per flush: %.1f", w.flushes ? (double)total.n / w.flushes : 0.0);
+  printf("\n");
+  latency_footer();
+
+  if(errors > 0){
+    fprintf(stderr, "ERROR: %d records failed to commit in wal_bench\n", errors);
+  }
+
+#ifdef PMEM
+  if(policy == WAL_PMEM) pmem_unmap(w.pmem_base, w.pmem_len);
+  else
+#endif
+  close(w.fd);
+  unlink(name);
+
+  free(w.buffer);
+  free(w.flushing);
+  free(writers);
+  fflush(stdout);
+
+  return errors > 0;
+}
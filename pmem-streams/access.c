@@ -0,0 +1,99 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+#include<stdio.h>
+#include<libpmem.h>
+#include<omp.h>
+#include"simd.h"
+#include"access.h"
+
+char *pattern_name(int pattern){
+
+  switch(pattern){
+  case PATTERN_STRIDED:
+    return "strided";
+  case PATTERN_RANDOM:
+    return "random";
+  default:
+    return "sequential";
+  }
+
+}
+
+/*
+ * Read or write each access-sized slot of buf (n doubles) once, in order,
+ * stride apart, or in a random order (with repeats, as random accesses in
+ * a real code would be). Sizes are in doubles. Every thread works on its
+ * own part of buf, split as for schedule(static). Strided passes go through
+ * the part stride apart, then again one slot further on, until every slot
+ * is visited. Writes store 1.0 and, when durable is set, are flushed as
+ * they are made (or the whole buffer is synced at the end). Returns the sum
+ * of everything read and the number of doubles read in n_read.
+ */
+double access_kernel(double *buf, long int n, long int access, long int stride, int pattern, int write, int durable, long int *n_read){
+
+  double sum = 0.0;
+  long int count = 0;
+
+#pragma omp parallel reduction(+:sum,count)
+  {
+    long int lo, hi, slots, per_stride, rows, i, j, slot = 0;
+    unsigned long long x = 0x9E3779B97F4A7C15ULL * (omp_get_thread_num()+1);
+    double *p;
+
+    static_range(n/access, &lo, &hi);
+    slots = hi - lo;
+
+    /* a strided pass visits rows slots, per_stride passes cover the part */
+    per_stride = stride > access ? stride/access : 1;
+    rows = slots/per_stride;
+    if(rows == 0){
+      rows = 1;
+      per_stride = slots;
+    }
+    if(pattern == PATTERN_STRIDED) slots = rows*per_stride;
+
+    for(i=0; i<slots; i++){
+      switch(pattern){
+      case PATTERN_STRIDED:
+        slot = (i % rows)*per_stride + i/rows;
+        break;
+      case PATTERN_RANDOM:
+        /* xorshift64 */
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        slot = x % slots;
+        break;
+      default:
+        slot = i;
+      }
+      p = buf + (lo+slot)*access;
+      if(write){
+        for(j=0; j<access; j++){
+          p[j] = 1.0;
+        }
+        if(durable == DURABLE_FLUSH) pmem_flush(p, access*sizeof(double));
+      }else{
+#pragma omp simd reduction(+:sum)
+        for(j=0; j<access; j++){
+          sum += p[j];
+        }
+        count += access;
+      }
+    }
+
+    if(write && durable == DURABLE_FLUSH) pmem_drain();
+  }
+
+  if(write && durable == DURABLE_MSYNC) pmem_msync(buf, n*sizeof(double));
+
+  *n_read = count;
+  return sum;
+
+}
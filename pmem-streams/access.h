@@ -0,0 +1,25 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* Access size and pattern kernels for pmem-streams */
+
+#define PATTERN_SEQUENTIAL 0
+#define PATTERN_STRIDED 1
+#define PATTERN_RANDOM 2
+#define NUM_PATTERNS 3
+
+/* how writes are made durable */
+#define DURABLE_NONE 0
+#define DURABLE_FLUSH 1
+#define DURABLE_MSYNC 2
+
+/* default stride between strided accesses */
+#define ACCESS_STRIDE 4096
+
+char *pattern_name(int);
+double access_kernel(double *, long int, long int, long int, int, int, int, long int *);
@@ -0,0 +1,485 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+#define _GNU_SOURCE
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<sched.h>
+#include<unistd.h>
+#include<fcntl.h>
+#include<errno.h>
+#include<stdint.h>
+#include<sys/mman.h>
+#include<sys/syscall.h>
+#include<linux/mempolicy.h>
+#include<omp.h>
+#include"placement.h"
+
+/* set_pages chooses the pages alloc_array uses */
+static int page_mode = PAGES_NORMAL;
+
+/*
+ * The memory policy calls go straight to the system calls so there is no
+ * dependency on libnuma.
+ */
+
+static long sys_mbind(void *addr, unsigned long len, int mode, unsigned long *nodemask, unsigned long maxnode){
+  return syscall(SYS_mbind, addr, len, mode, nodemask, maxnode, 0);
+}
+
+static long sys_get_mempolicy(int *mode, unsigned long *nodemask, unsigned long maxnode, void *addr, unsigned long flags){
+  return syscall(SYS_get_mempolicy, mode, nodemask, maxnode, addr, flags);
+}
+
+int policy_from_name(char *name){
+
+  if(strcmp(name, "local") == 0) return POLICY_LOCAL;
+  if(strcmp(name, "interleave") == 0) return POLICY_INTERLEAVE;
+  if(strcmp(name, "bind") == 0) return POLICY_BIND;
+
+  return -1;
+}
+
+char *policy_name(int policy){
+
+  switch(policy){
+  case POLICY_INTERLEAVE:
+    return "interleave";
+  case POLICY_BIND:
+    return "bind";
+  default:
+    return "local";
+  }
+}
+
+int bind_from_name(char *name){
+
+  if(strcmp(name, "none") == 0) return BIND_NONE;
+  if(strcmp(name, "close") == 0 || strcmp(name, "compact") == 0) return BIND_CLOSE;
+  if(strcmp(name, "spread") == 0 || strcmp(name, "scatter") == 0) return BIND_SPREAD;
+
+  return -1;
+}
+
+int pages_from_name(char *name){
+
+  if(strcmp(name, "normal") == 0) return PAGES_NORMAL;
+  if(strcmp(name, "thp") == 0) return PAGES_THP;
+  if(strcmp(name, "2m") == 0) return PAGES_2M;
+  if(strcmp(name, "1g") == 0) return PAGES_1G;
+
+  return -1;
+}
+
+char *pages_name(int pages){
+
+  switch(pages){
+  case PAGES_THP:
+    return "transparent huge pages";
+  case PAGES_2M:
+    return "2 MiB hugetlbfs pages";
+  case PAGES_1G:
+    return "1 GiB hugetlbfs pages";
+  default:
+    return "normal pages";
+  }
+}
+
+void set_pages(int pages){
+
+  page_mode = pages;
+}
+
+/* hugetlb mappings must be a whole number of huge pages */
+static size_t mapping_bytes(size_t bytes){
+
+  switch(page_mode){
+  case PAGES_2M:
+    return (bytes+SIZE_2M-1)/SIZE_2M*SIZE_2M;
+  case PAGES_1G:
+    return (bytes+SIZE_1G-1)/SIZE_1G*SIZE_1G;
+  default:
+    return bytes;
+  }
+}
+
+char *bind_name(int bind){
+
+  switch(bind){
+  case BIND_CLOSE:
+    return "close";
+  case BIND_SPREAD:
+    return "spread";
+  default:
+    return "none";
+  }
+}
+
+static int read_list(char *filename, int *list, int max){
+
+  FILE *fp;
+  char buffer[4096];
+  char *tok, *saveptr = NULL;
+  int lo, hi, i, n = 0;
+
+  fp = fopen(filename, "r");
+  if(fp == NULL) return 0;
+  if(fgets(buffer, sizeof(buffer), fp) == NULL){
+    fclose(fp);
+    return 0;
+  }
+  fclose(fp);
+
+  /* sysfs lists look like 0-17,36-53 */
+  for(tok = strtok_r(buffer, ",\n", &saveptr); tok != NULL; tok = strtok_r(NULL, ",\n", &saveptr)){
+    if(sscanf(tok, "%d-%d", &lo, &hi) != 2){
+      if(sscanf(tok, "%d", &lo) != 1) continue;
+      hi = lo;
+    }
+    for(i=lo; i<=hi && n<max; i++){
+      list[n++] = i;
+    }
+  }
+
+  return n;
+}
+
+/*
+ * Fill nodes with the NUMA nodes that have memory (or cpus, if with_cpus is
+ * set). Systems without NUMA information are treated as a single node 0.
+ */
+int numa_nodes(int *nodes, int with_cpus){
+
+  int n;
+
+  n = read_list(with_cpus ? "/sys/devices/system/node/has_cpu" : "/sys/devices/system/node/has_memory", nodes, MAX_NODES);
+  if(n == 0){
+    nodes[0] = 0;
+    n = 1;
+  }
+
+  return n;
+}
+
+/* The cpus of a NUMA node, restricted to those this process may use. */
+int node_cpus(int node, int *cpus, int max){
+
+  char filename[128];
+  int all[MAX_CPUS];
+  int allowed[MAX_CPUS];
+  int n_all, n_allowed, i, j, n = 0;
+
+  snprintf(filename, sizeof(filename), "/sys/devices/system/node/node%d/cpulist", node);
+  n_all = read_list(filename, all, MAX_CPUS);
+  n_allowed = process_cpus(allowed, MAX_CPUS);
+
+  if(n_all == 0 && node == 0){
+    for(i=0; i<n_allowed && i<max; i++) cpus[i] = allowed[i];
+    return i;
+  }
+
+  for(i=0; i<n_all && n<max; i++){
+    for(j=0; j<n_allowed; j++){
+      if(all[i] == allowed[j]){
+        cpus[n++] = all[i];
+        break;
+      }
+    }
+  }
+
+  return n;
+}
+
+/*
+ * All of the cpus this process may run on. The affinity is recorded the
+ * first time this is called, before any threads have been pinned.
+ */
+int process_cpus(int *cpus, int max){
+
+  static cpu_set_t initial;
+  static int have_initial = 0;
+  int i, n = 0;
+
+  if(!have_initial){
+    CPU_ZERO(&initial);
+    if(sched_getaffinity(0, sizeof(cpu_set_t), &initial) != 0) return 0;
+    have_initial = 1;
+  }
+  for(i=0; i<CPU_SETSIZE && n<max; i++){
+    if(CPU_ISSET(i, &initial)) cpus[n++] = i;
+  }
+
+  return n;
+}
+
+/*
+ * Allocate a page aligned array and apply the placement policy before it is
+ * first touched: local leaves it to first touch by the initialising threads,
+ * interleave spreads pages across every node with memory and bind places
+ * every page on the given node.
+ */
+void *alloc_array(size_t bytes, int policy, int node){
+
+  unsigned long mask[MAX_NODES/(8*sizeof(unsigned long))];
+  int nodes[MAX_NODES];
+  int n, i;
+  void *addr;
+
+  int flags = MAP_PRIVATE|MAP_ANONYMOUS;
+
+  if(page_mode == PAGES_2M) flags |= MAP_HUGETLB | (21 << MAP_HUGE_SHIFT);
+  if(page_mode == PAGES_1G) flags |= MAP_HUGETLB | (30 << MAP_HUGE_SHIFT);
+
+  bytes = mapping_bytes(bytes);
+  addr = mmap(NULL, bytes, PROT_READ|PROT_WRITE, flags, -1, 0);
+  if(addr == MAP_FAILED){
+    if(flags & MAP_HUGETLB) perror("mmap with MAP_HUGETLB (are huge pages reserved?)");
+    return NULL;
+  }
+
+  /* only a hint, khugepaged may still leave some normal pages */
+  if(page_mode == PAGES_THP && madvise(addr, bytes, MADV_HUGEPAGE) != 0){
+    perror("madvise(MADV_HUGEPAGE)");
+  }
+  /* keep the baseline on normal pages when THP is set to always */
+  if(page_mode == PAGES_NORMAL && madvise(addr, bytes, MADV_NOHUGEPAGE) != 0){
+    perror("madvise(MADV_NOHUGEPAGE)");
+  }
+
+  memset(mask, 0, sizeof(mask));
+
+  if(policy == POLICY_LOCAL){
+    /*
+     * override any policy inherited from numactl so first touch decides,
+     * on this range only; kernels before 3.8 have no MPOL_LOCAL, where
+     * MPOL_PREFERRED with an empty mask means the same
+     */
+    if(sys_mbind(addr, bytes, MPOL_LOCAL, NULL, 0) != 0 &&
+       sys_mbind(addr, bytes, MPOL_PREFERRED, NULL, 0) != 0){
+      perror("mbind");
+      munmap(addr, bytes);
+      return NULL;
+    }
+    return addr;
+  }
+
+  if(policy == POLICY_INTERLEAVE){
+    n = numa_nodes(nodes, 0);
+    for(i=0; i<n; i++){
+      mask[nodes[i]/(8*sizeof(unsigned long))] |= 1UL << (nodes[i]%(8*sizeof(unsigned long)));
+    }
+  }else{
+    if(node < 0 || node >= MAX_NODES){
+      fprintf(stderr, "NUMA node %d is out of range\n", node);
+      munmap(addr, bytes);
+      return NULL;
+    }
+    mask[node/(8*sizeof(unsigned long))] |= 1UL << (node%(8*sizeof(unsigned long)));
+  }
+
+  if(sys_mbind(addr, bytes, policy == POLICY_INTERLEAVE ? MPOL_INTERLEAVE : MPOL_BIND, mask, MAX_NODES+1) != 0){
+    perror("mbind");
+    munmap(addr, bytes);
+    return NULL;
+  }
+
+  return addr;
+}
+
+void free_array(void *addr, size_t bytes){
+
+  munmap(addr, mapping_bytes(bytes));
+}
+
+/*
+ * The page size of the mapping holding addr, and how much of it is mapped
+ * with huge page table entries (transparent huge pages, or PMD mappings of
+ * a DAX file), both in kB, from /proc/self/smaps.
+ */
+int page_info(void *addr, long *page_kb, long *huge_kb){
+
+  FILE *fp;
+  char line[512];
+  unsigned long start, end;
+  long kb;
+  int found = 0;
+
+  *page_kb = 0;
+  *huge_kb = 0;
+
+  fp = fopen("/proc/self/smaps", "r");
+  if(fp == NULL) return 1;
+
+  while(fgets(line, sizeof(line), fp) != NULL){
+    /* a new mapping starts with its address range */
+    if(sscanf(line, "%lx-%lx ", &start, &end) == 2){
+      if(found) break;
+      found = (uintptr_t)addr >= start && (uintptr_t)addr < end;
+      continue;
+    }
+    if(!found) continue;
+    sscanf(line, "KernelPageSize: %ld kB", page_kb);
+    if(sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) *huge_kb += kb;
+    if(sscanf(line, "FilePmdMapped: %ld kB", &kb) == 1) *huge_kb += kb;
+  }
+  fclose(fp);
+
+  return found ? 0 : 1;
+}
+
+/*
+ * Create filename and map len bytes of it at an address aligned to align,
+ * so the kernel can use 2 MiB or 1 GiB page table entries for a DAX file.
+ * A reservation of len+align bytes is made first and the file is mapped
+ * over the aligned part with MAP_FIXED. MAP_SYNC is asked for, and if the
+ * kernel accepts it the file is on persistent memory and flushing the cpu
+ * caches makes stores durable, which is returned in is_pmem.
+ */
+void *map_aligned(char *filename, size_t len, size_t align, int *is_pmem){
+
+  char *reserve, *addr;
+  size_t head, mapped;
+  long page = sysconf(_SC_PAGESIZE);
+  int fd, err;
+
+  fd = open(filename, O_RDWR|O_CREAT|O_EXCL, 0666);
+  if(fd < 0) return NULL;
+  if((err = posix_fallocate(fd, 0, len)) != 0){
+    errno = err;
+    close(fd);
+    return NULL;
+  }
+
+  reserve = mmap(NULL, len+align, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+  if(reserve == MAP_FAILED){
+    close(fd);
+    return NULL;
+  }
+  addr = (char *)(((uintptr_t)reserve+align-1)/align*align);
+
+  *is_pmem = 0;
+#ifdef MAP_SYNC
+  if(mmap(addr, len, PROT_READ|PROT_WRITE, MAP_SHARED_VALIDATE|MAP_SYNC|MAP_FIXED, fd, 0) != MAP_FAILED){
+    *is_pmem = 1;
+  }else
+#endif
+  if(mmap(addr, len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED, fd, 0) == MAP_FAILED){
+    munmap(reserve, len+align);
+    close(fd);
+    return NULL;
+  }
+  close(fd);
+
+  /* give back the parts of the reservation either side; the file mapping ends on a page */
+  head = addr - reserve;
+  mapped = (len+page-1)/page*page;
+  if(head > 0 && munmap(reserve, head) != 0) perror("munmap");
+  if(align-head > 0 && munmap(addr+mapped, align-head) != 0) perror("munmap");
+
+  return addr;
+}
+
+/* NUMA node holding the (already touched) page at addr, or -1. */
+int address_node(void *addr){
+
+  int node = -1;
+
+  if(sys_get_mempolicy(&node, NULL, 0, addr, MPOL_F_NODE|MPOL_F_ADDR) != 0) return -1;
+
+  return node;
+}
+
+/*
+ * Pin the threads of the OpenMP team to cpus. close places consecutive
+ * threads on consecutive cpus of the list, spread deals threads out across
+ * the NUMA nodes the cpus belong to in turn. Because the kernels use a
+ * static schedule, each thread keeps working on the same part of the arrays
+ * and so stays next to the pages it first touched. BIND_NONE restores the
+ * process affinity and leaves placement to OMP_PLACES/OMP_PROC_BIND.
+ */
+int pin_threads(int *cpus, int n_cpus, int bind){
+
+  static int pinned = 0;
+  int order[MAX_CPUS];
+  int cpu_node[MAX_CPUS];
+  int used[MAX_CPUS];
+  int node_list[MAX_CPUS];
+  int allowed[MAX_CPUS];
+  int nodes[MAX_NODES];
+  int n_nodes, n_node_cpus, n_allowed, i, j, c, n = 0, failed = 0;
+
+  /* leave OpenMP's own binding alone unless we changed it earlier */
+  if(bind == BIND_NONE && !pinned) return 0;
+  pinned = bind != BIND_NONE;
+
+  if(n_cpus < 1) return 1;
+  if(n_cpus > MAX_CPUS) n_cpus = MAX_CPUS;
+
+  if(bind == BIND_SPREAD){
+    /* find the node of every cpu, then deal the cpus out one node at a time */
+    n_nodes = numa_nodes(nodes, 1);
+    for(i=0; i<n_cpus; i++){
+      cpu_node[i] = -1;
+      used[i] = 0;
+    }
+    for(j=0; j<n_nodes; j++){
+      n_node_cpus = node_cpus(nodes[j], node_list, MAX_CPUS);
+      for(i=0; i<n_cpus; i++){
+        for(c=0; c<n_node_cpus; c++){
+          if(node_list[c] == cpus[i]) cpu_node[i] = j;
+        }
+      }
+    }
+    while(n < n_cpus){
+      /* node -1 picks up any cpu that is not listed under a node */
+      for(j=-1; j<n_nodes; j++){
+        for(i=0; i<n_cpus; i++){
+          if(!used[i] && cpu_node[i] == j){
+            order[n++] = cpus[i];
+            used[i] = 1;
+            break;
+          }
+        }
+      }
+    }
+  }else{
+    for(i=0; i<n_cpus; i++) order[i] = cpus[i];
+  }
+
+  n_allowed = process_cpus(allowed, MAX_CPUS);
+
+#pragma omp parallel private(i) reduction(+:failed)
+  {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if(bind == BIND_NONE){
+      for(i=0; i<n_allowed; i++) CPU_SET(allowed[i], &cpuset);
+    }else{
+      CPU_SET(order[omp_get_thread_num() % n_cpus], &cpuset);
+    }
+    if(sched_setaffinity(0, sizeof(cpu_set_t), &cpuset) != 0) failed++;
+  }
+
+  return failed;
+}
+
+/* Say how OpenMP itself has been asked to place threads. */
+void report_openmp_binding(void){
+
+  char *places = getenv("OMP_PLACES");
+  char *proc_bind = getenv("OMP_PROC_BIND");
+
+#if _OPENMP >= 201511
+  printf("OpenMP proc_bind policy %d, %d places (OMP_PLACES=%s, OMP_PROC_BIND=%s)\n",
+         (int) omp_get_proc_bind(), omp_get_num_places(), places ? places : "unset", proc_bind ? proc_bind : "unset");
+#else
+  printf("OMP_PLACES=%s, OMP_PROC_BIND=%s\n", places ? places : "unset", proc_bind ? proc_bind : "unset");
+#endif
+}
@@ -0,0 +1,51 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* NUMA memory placement and OpenMP thread pinning for pmem-streams */
+
+#include <stddef.h>
+
+#define MAX_NODES 64
+#define MAX_CPUS 4096
+
+/* DRAM placement policies */
+#define POLICY_LOCAL 0
+#define POLICY_INTERLEAVE 1
+#define POLICY_BIND 2
+
+/* thread pinning */
+#define BIND_NONE 0
+#define BIND_CLOSE 1
+#define BIND_SPREAD 2
+
+/* pages backing the DRAM arrays */
+#define PAGES_NORMAL 0
+#define PAGES_THP 1
+#define PAGES_2M 2
+#define PAGES_1G 3
+
+#define SIZE_2M (2UL*1024*1024)
+#define SIZE_1G (1024UL*1024*1024)
+
+int policy_from_name(char *);
+char *policy_name(int);
+int bind_from_name(char *);
+char *bind_name(int);
+int numa_nodes(int *, int);
+int node_cpus(int, int *, int);
+int process_cpus(int *, int);
+void *alloc_array(size_t, int, int);
+void free_array(void *, size_t);
+int address_node(void *);
+int pin_threads(int *, int, int);
+void report_openmp_binding(void);
+int pages_from_name(char *);
+char *pages_name(int);
+void set_pages(int);
+int page_info(void *, long *, long *);
+void *map_aligned(char *, size_t, size_t, int *);
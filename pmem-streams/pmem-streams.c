@@ -2,167 +2,1296 @@
 #include<stdlib.h>
 #include<time.h>
 #include<string.h>
+#include<math.h>
+#include<limits.h>
+#include<stdint.h>
+#include<unistd.h>
+#include<getopt.h>
 #include<libpmem.h>
 #include<omp.h>
 #include"utils.h"
+#include"placement.h"
+#include"simd.h"
+#include"access.h"
+#include"tlb.h"
 #define ARRAY_SIZE 100000000
 #define MB 1048576
 #define REPEATS 10
 
+#define COPY 0
+#define SCALE 1
+#define ADD 2
+#define TRIADD 3
+#define NUM_KERNELS 4
+
+#define SCALAR 2.4
+
+/* how the pmem kernels make their destination array durable */
+#define PERSIST_NONE 0
+#define PERSIST_END 1
+#define PERSIST_CHUNK 2
+#define PERSIST_NT 3
+#define NUM_PERSIST 4
+
+#define PERSIST_CHUNK_BYTES 262144
+
+/* read/write mixes work on blocks of this many doubles (512 bytes) */
+#define MIX_BLOCK 64
+#define MAX_MIXES 32
+
+#define MAX_ACCESS_SIZES 16
+/* the smallest unit each medium moves, for the access efficiency */
+#define DRAM_GRANULE 64
+#define PMEM_GRANULE 256
+
+static char *kernel_names[NUM_KERNELS] = {"Copy", "Scale", "Add", "Triadd"};
+/* number of arrays each kernel reads or writes, for the bandwidth figures */
+static int kernel_arrays[NUM_KERNELS] = {2, 2, 3, 3};
+static char *persist_names[NUM_PERSIST] = {"none", "end", "chunk", "nt"};
+/* bytes written between flushes in the chunk mode */
+static long int persist_chunk = PERSIST_CHUNK_BYTES;
+/* set when the file is not on persistent memory, so msync is needed */
+static int use_msync = 0;
+/* the pmem mapping, only arrays inside it are made durable */
+static char *pmem_base = NULL;
+static size_t pmem_len = 0;
+
 void copy(double *, double *, long int);
 void scale(double *, double *, double, long int);
 void add(double *, double *, double *, long int);
 void triadd(double *, double *, double *, double, long int);
 void initialise(double *, double *, double *, long int);
+void run_kernels(struct kernel_set *, double *, double *, double *, long int, int, int, int, double *, double *);
+void run_kernel(struct kernel_set *, int, double *, double *, double *, long int, long int);
+void persistent_kernel(struct kernel_set *, int, double *, double *, double *, long int, int);
+void make_durable(double *, long int);
+int on_pmem(double *);
+int check_results(double *, double *, double *, long int, int);
+int numa_matrix(double *, double *, double *, long int, int, int, int, int);
+int tier_matrix(double *, double *, double *, long int, int, int, int, int);
+int thread_sweep(double *, double *, double *, long int, int, int, int, int, int, int, char *);
+int parse_mixes(char *, int *, int *);
+int run_mixes(double *, double *, long int, int, int, int *, int *, int, double *);
+double mix_kernel(double *, double *, long int, int, int, int, long int *);
+int parse_sizes(char *, long int *);
+int run_access(double *, long int, int, long int *, int, long int, int, double *);
+void print_access(char *, long int, long int *, int, double *);
+void print_array_nodes(double *, double *, double *);
+void print_pages(char *, void *);
+int select_kernel_sets(char *, int *);
+void usage(char *);
+double seconds(void);
+
+/* the plain C loops, vectorised (or not) by the compiler */
+static struct kernel_set plain_kernels = {"compiler", ISA_NONE, 0, copy, scale, add, triadd};
+
+static struct option long_options[] = {
+  {"size", required_argument, 0, 's'},
+  {"repeats", required_argument, 0, 'r'},
+  {"path", required_argument, 0, 'p'},
+  {"policy", required_argument, 0, 'P'},
+  {"node", required_argument, 0, 'n'},
+  {"bind", required_argument, 0, 'b'},
+  {"numa-matrix", no_argument, 0, 'm'},
+  {"simd", required_argument, 0, 'S'},
+  {"persist", required_argument, 0, 'f'},
+  {"persist-chunk", required_argument, 0, 'c'},
+  {"tiers", no_argument, 0, 't'},
+  {"sweep", required_argument, 0, 'w'},
+  {"mix", required_argument, 0, 'x'},
+  {"access", required_argument, 0, 'a'},
+  {"stride", required_argument, 0, 'd'},
+  {"pages", required_argument, 0, 'g'},
+  {"pmem-align", required_argument, 0, 'A'},
+  {"help", no_argument, 0, 'h'},
+  {0, 0, 0, 0}
+};
+
 int main(int argc, char *argv[]){
 
-  struct timespec start, end;
-  
   char *path;
-  char title[100] = "";
+  char filename[PATH_MAX] = "";
   double *a, *b, *c;
   char *pmemaddr = NULL;
-  long int array_size, bytes;
+  long int array_size;
   int repeats;
-  int i;
   int array_element_size;
   int is_pmem;
   size_t mapped_len;
   int num_threads;
- 
-  if(argc != 4){
-    array_size = ARRAY_SIZE;
-    repeats = REPEATS;
-    path = "";
-  }else{
-    array_size = atoi(argv[1]);
-    repeats = atoi(argv[2]);
-    path = argv[3];
+  int errors = 0;
+  double dram_best[NUM_KERNELS], pmem_best[NUM_KERNELS];
+  int k;
+  int opt;
+  int policy = POLICY_LOCAL;
+  int node = 0;
+  int bind = BIND_NONE;
+  int matrix = 0;
+  int cpus[MAX_CPUS];
+  int n_cpus;
+  char *simd = NULL;
+  int *selected;
+  double *simd_dram, *simd_pmem;
+  int i;
+  int persist = PERSIST_END;
+  int tiers = 0;
+  char *sweep = NULL;
+  int mix_reads[MAX_MIXES], mix_writes[MAX_MIXES];
+  double mix_dram[MAX_MIXES], mix_pmem[MAX_MIXES];
+  int n_mixes = 0;
+  long int access_sizes[MAX_ACCESS_SIZES];
+  int n_access = 0;
+  long int stride = ACCESS_STRIDE;
+  double *access_dram, *access_pmem;
+  int pages = PAGES_NORMAL;
+  size_t pmem_align = 0;
+  double dram_tlb[NUM_KERNELS], pmem_tlb[NUM_KERNELS];
+  int tlb;
+
+  array_size = ARRAY_SIZE;
+  repeats = REPEATS;
+  path = "";
+
+  while((opt = getopt_long(argc, argv, "s:r:p:P:n:b:mS:f:c:tw:x:a:d:g:A:h", long_options, NULL)) != -1){
+    switch(opt){
+    case 's':
+      array_size = atol(optarg);
+      break;
+    case 'r':
+      repeats = atoi(optarg);
+      break;
+    case 'p':
+      path = optarg;
+      break;
+    case 'P':
+      if((policy = policy_from_name(optarg)) < 0){
+        fprintf(stderr, "Unknown placement policy %s\n", optarg);
+        usage(argv[0]);
+      }
+      break;
+    case 'n':
+      node = atoi(optarg);
+      break;
+    case 'b':
+      if((bind = bind_from_name(optarg)) < 0){
+        fprintf(stderr, "Unknown thread binding %s\n", optarg);
+        usage(argv[0]);
+      }
+      break;
+    case 'm':
+      matrix = 1;
+      break;
+    case 'S':
+      simd = optarg;
+      break;
+    case 'f':
+      for(persist=0; persist<NUM_PERSIST; persist++){
+        if(strcmp(optarg, persist_names[persist]) == 0) break;
+      }
+      if(persist == NUM_PERSIST){
+        fprintf(stderr, "Unknown persistence mode %s\n", optarg);
+        usage(argv[0]);
+      }
+      break;
+    case 't':
+      tiers = 1;
+      break;
+    case 'w':
+      sweep = optarg;
+      break;
+    case 'a':
+      if((n_access = parse_sizes(optarg, access_sizes)) < 1){
+        fprintf(stderr, "Bad access size list %s, sizes must be multiples of %d bytes\n", optarg, (int)sizeof(double));
+        usage(argv[0]);
+      }
+      break;
+    case 'd':
+      stride = atol(optarg);
+      if(stride < (long int)sizeof(double) || stride % sizeof(double) != 0){
+        fprintf(stderr, "The stride must be a multiple of %d bytes\n", (int)sizeof(double));
+        usage(argv[0]);
+      }
+      break;
+    case 'g':
+      if((pages = pages_from_name(optarg)) < 0){
+        fprintf(stderr, "Unknown page size %s\n", optarg);
+        usage(argv[0]);
+      }
+      break;
+    case 'A':
+      if(strcmp(optarg, "2m") == 0){
+        pmem_align = SIZE_2M;
+      }else if(strcmp(optarg, "1g") == 0){
+        pmem_align = SIZE_1G;
+      }else{
+        fprintf(stderr, "Unknown pmem mapping alignment %s\n", optarg);
+        usage(argv[0]);
+      }
+      break;
+    case 'x':
+      if((n_mixes = parse_mixes(optarg, mix_reads, mix_writes)) < 1){
+        fprintf(stderr, "Bad read:write mix list %s\n", optarg);
+        usage(argv[0]);
+      }
+      break;
+    case 'c':
+      persist_chunk = atol(optarg);
+      if(persist_chunk < (long int)sizeof(double) || persist_chunk % sizeof(double) != 0){
+        fprintf(stderr, "The persist chunk must be a multiple of %d bytes\n", (int)sizeof(double));
+        usage(argv[0]);
+      }
+      break;
+    default:
+      usage(argv[0]);
+    }
   }
 
-  a = malloc(sizeof(double)*array_size);
-  b = malloc(sizeof(double)*array_size);
-  c = malloc(sizeof(double)*array_size);
+  /* the original positional form: array_size repeats path */
+  if(argc - optind == 3){
+    array_size = atol(argv[optind]);
+    repeats = atoi(argv[optind+1]);
+    path = argv[optind+2];
+  }else if(argc != optind){
+    usage(argv[0]);
+  }
+
+  /* the first iteration is a warm-up, so at least one more is needed */
+  if(repeats < 2){
+    fprintf(stderr, "At least 2 repeats are needed, the first one is not included in the results\n");
+    exit(-1);
+  }
+
+  selected = calloc(num_simd_kernel_sets+1, sizeof(int));
+  simd_dram = calloc((num_simd_kernel_sets+1)*NUM_KERNELS, sizeof(double));
+  simd_pmem = calloc((num_simd_kernel_sets+1)*NUM_KERNELS, sizeof(double));
+  if(selected == NULL || simd_dram == NULL || simd_pmem == NULL){
+    fprintf(stderr, "Failed to allocate the SIMD results\n");
+    exit(-1);
+  }
+  if(simd != NULL && select_kernel_sets(simd, selected) != 0){
+    fprintf(stderr, "Unknown or unsupported SIMD kernels %s\n", simd);
+    usage(argv[0]);
+  }
+
+  /* the chunk mode calls the kernels from inside a parallel loop */
+  omp_set_max_active_levels(1);
+
+  for(i=0; i<n_access; i++){
+    if(access_sizes[i] > array_size*(long int)sizeof(double)){
+      fprintf(stderr, "Access size %ld is bigger than the arrays\n", access_sizes[i]);
+      exit(-1);
+    }
+  }
+  access_dram = calloc(MAX_ACCESS_SIZES*NUM_PATTERNS*2, sizeof(double));
+  access_pmem = calloc(MAX_ACCESS_SIZES*NUM_PATTERNS*2, sizeof(double));
+  if(access_dram == NULL || access_pmem == NULL){
+    fprintf(stderr, "Failed to allocate the access results\n");
+    exit(-1);
+  }
+
+  n_cpus = process_cpus(cpus, MAX_CPUS);
+  if(pin_threads(cpus, n_cpus, bind) != 0){
+    fprintf(stderr, "Failed to pin the OpenMP threads, carrying on unpinned\n");
+  }
+
+  /* count in every thread of the team the kernels will run on */
+  tlb = tlb_open();
+
+  set_pages(pages);
+  a = alloc_array(sizeof(double)*array_size, policy, node);
+  b = alloc_array(sizeof(double)*array_size, policy, node);
+  c = alloc_array(sizeof(double)*array_size, policy, node);
+  if(a == NULL || b == NULL || c == NULL){
+    fprintf(stderr, "Failed to allocate the DRAM arrays\n");
+    exit(-1);
+  }
 
   array_element_size = sizeof(a[0]);
 
   printf("Using an array of %ld doubles (%ld MB) for experiments\n",array_size,array_size*array_element_size/MB);
+  printf("Each kernel is run %d times, the first iteration is not included in the results\n", repeats);
 #pragma omp parallel shared(num_threads)
   {
     num_threads = omp_get_num_threads();
   }
   printf("Running on %d threads\n", num_threads);
+  if(policy == POLICY_BIND){
+    printf("DRAM placement policy: %s to node %d\n", policy_name(policy), node);
+  }else{
+    printf("DRAM placement policy: %s\n", policy_name(policy));
+  }
+  printf("Thread binding: %s over %d cpus\n", bind_name(bind), n_cpus);
+  report_openmp_binding();
+  printf("Widest SIMD instruction set supported: %s\n", isa_name(best_isa()));
+  printf("DRAM arrays use %s\n", pages_name(pages));
+  if(tlb == 0){
+    printf("dTLB miss counters are not available (see /proc/sys/kernel/perf_event_paranoid)\n");
+  }
 
   printf("Memory test\n");
 
   initialise(a,b,c,array_size);
 
-  clock_gettime(CLOCK_MONOTONIC, &start);
-  for(i=0; i<repeats; i++){
-    copy(a,b,array_size);
-  }
-  clock_gettime(CLOCK_MONOTONIC, &end);
-  strcpy(title, "Copy");
-  elapsed_time_bw_hr(start, end, repeats, (2*array_size*array_element_size)/MB, title);
+  print_array_nodes(a,b,c);
+  print_pages("a[]", a);
 
-  clock_gettime(CLOCK_MONOTONIC, &start);
-  for(i=0; i<repeats; i++){
-    scale(a,c,2.4,array_size);
-  }
-  clock_gettime(CLOCK_MONOTONIC, &end);
-  strcpy(title, "Scale");
-  elapsed_time_bw_hr(start, end, repeats, (2*array_size*array_element_size)/MB, title);
+  run_kernels(&plain_kernels,a,b,c,array_size,repeats,0,1,dram_best,dram_tlb);
 
-  clock_gettime(CLOCK_MONOTONIC, &start);
-  for(i=0; i<repeats; i++){
-    add(b,a,c,array_size);
-  }
-  clock_gettime(CLOCK_MONOTONIC, &end);
-  strcpy(title, "Add");
-  elapsed_time_bw_hr(start, end, repeats, (3*array_size*array_element_size)/MB, title);
+  errors += check_results(a,b,c,array_size,1);
 
-  clock_gettime(CLOCK_MONOTONIC, &start);
-  for(i=0; i<repeats; i++){
-    triadd(a,b,c,2.4,array_size);
+  /* the arrays already hold the values the kernels produce */
+  for(i=0; i<num_simd_kernel_sets; i++){
+    if(!selected[i]) continue;
+    run_kernels(&simd_kernel_sets[i],a,b,c,array_size,repeats,0,0,&simd_dram[i*NUM_KERNELS],NULL);
+    errors += check_results(a,b,c,array_size,0);
   }
-  clock_gettime(CLOCK_MONOTONIC, &end);
-  strcpy(title, "Triadd");
-  elapsed_time_bw_hr(start, end, repeats, (3*array_size*array_element_size)/MB, title);
 
-  free(a);
-  free(b);
-  free(c);
+  errors += run_mixes(a,b,array_size,repeats,PERSIST_NONE,mix_reads,mix_writes,n_mixes,mix_dram);
+
+  errors += run_access(a,array_size,repeats,access_sizes,n_access,stride,DURABLE_NONE,access_dram);
+
+  free_array(a, sizeof(double)*array_size);
+  free_array(b, sizeof(double)*array_size);
+  free_array(c, sizeof(double)*array_size);
 
   printf("PMem test\n");
 
-  sprintf(path+strlen(path), "pstream_test_file");
+  snprintf(filename, sizeof(filename), "%spstream_test_file", path);
 
-  if ((pmemaddr = pmem_map_file(path, array_size*array_element_size*3,
+  if(pmem_align > 0){
+    /* pmem_map_file has no way to ask for an alignment */
+    mapped_len = array_size*array_element_size*3;
+    if ((pmemaddr = map_aligned(filename, mapped_len, pmem_align, &is_pmem)) == NULL) {
+      perror("map_aligned");
+      fprintf(stderr, "Failed to map %ld byte aligned filename:%s.\n", (long)pmem_align, filename);
+      exit(-100);
+    }
+  }else if ((pmemaddr = pmem_map_file(filename, array_size*array_element_size*3,
 				PMEM_FILE_CREATE|PMEM_FILE_EXCL,
 				0666, &mapped_len, &is_pmem)) == NULL) {
     perror("pmem_map_file");
-    fprintf(stderr, "Failed to pmem_map_file for filename:%s.\n", path);
+    fprintf(stderr, "Failed to pmem_map_file for filename:%s.\n", filename);
     exit(-100);
   }
 
-  printf("Using file %s for pmem\n",path);
+  printf("Using file %s for pmem, mapped at %p (%s2 MiB aligned, %s1 GiB aligned)\n", filename, (void *)pmemaddr,
+         (uintptr_t)pmemaddr % SIZE_2M == 0 ? "" : "not ", (uintptr_t)pmemaddr % SIZE_1G == 0 ? "" : "not ");
 
-  a = pmemaddr;
-  b = pmemaddr + array_size*array_element_size;
-  c = pmemaddr + array_size*array_element_size*2;
+  use_msync = !is_pmem;
+  pmem_base = pmemaddr;
+  pmem_len = mapped_len;
+  if(persist == PERSIST_CHUNK){
+    printf("PMem persistence: %s, every %ld bytes%s\n", persist_names[persist], persist_chunk, use_msync ? " (not pmem, using msync)" : "");
+  }else{
+    printf("PMem persistence: %s%s\n", persist_names[persist], use_msync ? " (not pmem, using msync)" : "");
+  }
+
+  a = (double *)pmemaddr;
+  b = (double *)(pmemaddr + array_size*array_element_size);
+  c = (double *)(pmemaddr + array_size*array_element_size*2);
 
   initialise(a,b,c,array_size);
 
-  clock_gettime(CLOCK_MONOTONIC, &start);
-  for(i=0; i<repeats; i++){
-    copy(a,b,array_size);
-    pmem_persist(pmemaddr, array_size*array_element_size);
+  print_array_nodes(a,b,c);
+  print_pages("the pmem mapping", pmemaddr);
+
+  run_kernels(&plain_kernels,a,b,c,array_size,repeats,persist,1,pmem_best,pmem_tlb);
+
+  errors += check_results(a,b,c,array_size,1);
+
+  for(i=0; i<num_simd_kernel_sets; i++){
+    if(!selected[i]) continue;
+    run_kernels(&simd_kernel_sets[i],a,b,c,array_size,repeats,persist,0,&simd_pmem[i*NUM_KERNELS],NULL);
+    errors += check_results(a,b,c,array_size,0);
   }
-  clock_gettime(CLOCK_MONOTONIC, &end);
-  strcpy(title, "Copy");
-  elapsed_time_bw_hr(start, end, repeats, (2*array_size*array_element_size)/MB, title);
 
-  clock_gettime(CLOCK_MONOTONIC, &start);
-  for(i=0; i<repeats; i++){
-    scale(a,c,2.4,array_size);
+  errors += run_mixes(a,b,array_size,repeats,persist,mix_reads,mix_writes,n_mixes,mix_pmem);
+
+  errors += run_access(a,array_size,repeats,access_sizes,n_access,stride,
+                       persist == PERSIST_NONE ? DURABLE_NONE : use_msync ? DURABLE_MSYNC : DURABLE_FLUSH,access_pmem);
+
+  if(tiers){
+    errors += tier_matrix(a,b,c,array_size,repeats,persist,policy,node);
   }
-  clock_gettime(CLOCK_MONOTONIC, &end);
-  strcpy(title, "Scale");
-  elapsed_time_bw_hr(start, end, repeats, (2*array_size*array_element_size)/MB, title);
 
-  clock_gettime(CLOCK_MONOTONIC, &start);
-  for(i=0; i<repeats; i++){
-    add(b,a,c,array_size);
+  if(sweep != NULL){
+    errors += thread_sweep(a,b,c,array_size,repeats,persist,policy,node,bind,omp_get_max_threads(),sweep);
   }
-  clock_gettime(CLOCK_MONOTONIC, &end);
-  strcpy(title, "Add");
-  elapsed_time_bw_hr(start, end, repeats, (3*array_size*array_element_size)/MB, title);
 
-  clock_gettime(CLOCK_MONOTONIC, &start);
-  for(i=0; i<repeats; i++){
-    triadd(a,b,c,2.4,array_size);
+  if(matrix){
+    errors += numa_matrix(a,b,c,array_size,repeats,bind,persist,omp_get_max_threads());
   }
-  clock_gettime(CLOCK_MONOTONIC, &end);
-  strcpy(title, "Triadd");
-  elapsed_time_bw_hr(start, end, repeats, (3*array_size*array_element_size)/MB, title);
 
   pmem_persist(pmemaddr, mapped_len);
 
   pmem_unmap(pmemaddr, mapped_len);
 
+  unlink(filename);
+
+  if(simd != NULL){
+    printf("\n--- SIMD kernel variants, best bandwidth -------------------------------------------\n");
+    printf("|\n");
+    printf("| %-10s %-8s %16s %16s %12s\n", "Variant", "Kernel", "DRAM MB/s", "PMem MB/s", "DRAM/PMem");
+    for(k=0; k<NUM_KERNELS; k++){
+      printf("| %-10s %-8s %16.3f %16.3f %12.3f\n", plain_kernels.name, kernel_names[k], dram_best[k], pmem_best[k], dram_best[k]/pmem_best[k]);
+    }
+    for(i=0; i<num_simd_kernel_sets; i++){
+      if(!selected[i]) continue;
+      printf("|\n");
+      for(k=0; k<NUM_KERNELS; k++){
+        printf("| %-10s %-8s %16.3f %16.3f %12.3f\n", simd_kernel_sets[i].name, kernel_names[k],
+               simd_dram[i*NUM_KERNELS+k], simd_pmem[i*NUM_KERNELS+k], simd_dram[i*NUM_KERNELS+k]/simd_pmem[i*NUM_KERNELS+k]);
+      }
+    }
+    printf("|\n");
+    printf("------------------------------------------------------------------------------------\n");
+  }
+
+  free(selected);
+  free(simd_dram);
+  free(simd_pmem);
+
+  if(n_access > 0){
+    print_access("DRAM", DRAM_GRANULE, access_sizes, n_access, access_dram);
+    print_access("PMem", PMEM_GRANULE, access_sizes, n_access, access_pmem);
+  }
+  free(access_dram);
+  free(access_pmem);
+
+  if(n_mixes > 0){
+    printf("\n--- Read/write mixes, best bandwidth (bytes read and written) ----------------------\n");
+    printf("|\n");
+    printf("| %-8s %8s %16s %16s %12s\n", "R:W", "Read %", "DRAM MB/s", "PMem MB/s", "DRAM/PMem");
+    for(i=0; i<n_mixes; i++){
+      printf("| %3d:%-4d %8.1f %16.3f %16.3f %12.3f\n", mix_reads[i], mix_writes[i], 100.0*mix_reads[i]/(mix_reads[i]+mix_writes[i]),
+             mix_dram[i], mix_pmem[i], mix_dram[i]/mix_pmem[i]);
+    }
+    printf("|\n");
+    printf("------------------------------------------------------------------------------------\n");
+  }
+
+  printf("\n--- Best bandwidth summary ----------------------------------------------------------\n");
+  printf("|\n");
+  if(tlb > 0){
+    printf("| %-8s %16s %16s %12s %14s %14s\n", "Kernel", "DRAM MB/s", "PMem MB/s", "DRAM/PMem", "DRAM dTLB/MB", "PMem dTLB/MB");
+    for(k=0; k<NUM_KERNELS; k++){
+      printf("| %-8s %16.3f %16.3f %12.3f %14.3f %14.3f\n", kernel_names[k], dram_best[k], pmem_best[k], dram_best[k]/pmem_best[k], dram_tlb[k], pmem_tlb[k]);
+    }
+  }else{
+    printf("| %-8s %16s %16s %12s\n", "Kernel", "DRAM MB/s", "PMem MB/s", "DRAM/PMem");
+    for(k=0; k<NUM_KERNELS; k++){
+      printf("| %-8s %16.3f %16.3f %12.3f\n", kernel_names[k], dram_best[k], pmem_best[k], dram_best[k]/pmem_best[k]);
+    }
+  }
+  printf("|\n");
+  printf("| %s\n", errors == 0 ? "All results validated" : "VALIDATION FAILED, do not use these results");
+  printf("------------------------------------------------------------------------------------\n");
+
+  tlb_close();
+
+  return errors;
+
+}
+
+/*
+ * Run every kernel repeats times in the same order as STREAM, timing each
+ * kernel invocation on its own, then report the per-iteration timings and
+ * the best, average and worst bandwidth for each kernel. The best bandwidth
+ * of each kernel is returned in best. Nothing is printed unless verbose is
+ * set. persist selects how the destination of each kernel is made durable,
+ * which is included in the time. If misses is not NULL it gets the average
+ * dTLB misses per MB moved by each kernel, or -1 without counters.
+ */
+void run_kernels(struct kernel_set *ks, double *a, double *b, double *c, long int array_size, int repeats, int persist, int verbose, double *best, double *misses){
+
+  double *times[NUM_KERNELS];
+  double start;
+  double mbytes;
+  double min_time;
+  long long tlb_misses[NUM_KERNELS];
+  long long count;
+  int i, k;
+
+  /* non-temporal stores need the streaming variant of the kernels */
+  if(persist == PERSIST_NT && !ks->nt){
+    if(streaming_kernels(ks->isa) != NULL){
+      ks = streaming_kernels(ks->isa);
+      if(verbose) printf("Using the %s kernels for non-temporal stores\n", ks->name);
+    }else{
+      if(verbose) printf("No streaming store kernels on this cpu, flushing at the end instead\n");
+      persist = PERSIST_END;
+    }
+  }
+
+  for(k=0; k<NUM_KERNELS; k++){
+    times[k] = malloc(sizeof(double)*repeats);
+    if(times[k] == NULL){
+      fprintf(stderr, "Failed to allocate the timing arrays\n");
+      exit(-1);
+    }
+  }
+
+  for(k=0; k<NUM_KERNELS; k++){
+    tlb_misses[k] = 0;
+  }
+
+  for(i=0; i<repeats; i++){
+    for(k=0; k<NUM_KERNELS; k++){
+      if(misses != NULL) tlb_start();
+      start = seconds();
+      persistent_kernel(ks,k,a,b,c,array_size,persist);
+      times[k][i] = seconds() - start;
+      if(misses != NULL){
+        count = tlb_stop();
+        /* the warm-up iteration is left out, as for the timings */
+        if(count < 0) tlb_misses[k] = -1;
+        else if(i > 0 && tlb_misses[k] >= 0) tlb_misses[k] += count;
+      }
+    }
+  }
+
+  for(k=0; k<NUM_KERNELS; k++){
+    mbytes = (double)kernel_arrays[k]*array_size*sizeof(double)/MB;
+    if(verbose){
+      min_time = elapsed_time_stats_hr(times[k], repeats, mbytes, kernel_names[k]);
+    }else{
+      min_time = times[k][1];
+      for(i=2; i<repeats; i++){
+        if(times[k][i] < min_time) min_time = times[k][i];
+      }
+    }
+    best[k] = mbytes/min_time;
+    if(misses != NULL){
+      misses[k] = tlb_misses[k] < 0 ? -1.0 : (double)tlb_misses[k]/(repeats-1)/mbytes;
+      if(verbose && tlb_misses[k] >= 0) printf("%s: %.3f dTLB misses per MB\n", kernel_names[k], misses[k]);
+    }
+    free(times[k]);
+  }
+
+  return;
+
+}
+
+/* Run kernel k over elements lo to hi-1 of the arrays. */
+void run_kernel(struct kernel_set *ks, int k, double *a, double *b, double *c, long int lo, long int hi){
+
+  switch(k){
+  case COPY:
+    ks->copy(a+lo,b+lo,hi-lo);
+    break;
+  case SCALE:
+    ks->scale(a+lo,c+lo,SCALAR,hi-lo);
+    break;
+  case ADD:
+    ks->add(b+lo,a+lo,c+lo,hi-lo);
+    break;
+  default:
+    ks->triadd(a+lo,b+lo,c+lo,SCALAR,hi-lo);
+  }
+
+}
+
+/*
+ * Run kernel k and make the array it writes (b for copy, c otherwise)
+ * durable: not at all, with one flush of the whole array at the end, with a
+ * flush after every persist_chunk bytes, or, for streaming stores that
+ * bypass the cache, with a flush of the few lines written with ordinary
+ * stores and a drain.
+ */
+void persistent_kernel(struct kernel_set *ks, int k, double *a, double *b, double *c, long int array_size, int persist){
+
+  double *dest = k == COPY ? b : c;
+  long int chunk = persist_chunk/sizeof(double);
+  long int n_chunks = (array_size+chunk-1)/chunk;
+  long int ch, lo, hi;
+
+  /* a DRAM destination has nothing to make durable */
+  if(!on_pmem(dest) && persist != PERSIST_NT) persist = PERSIST_NONE;
+
+  switch(persist){
+  case PERSIST_END:
+    run_kernel(ks,k,a,b,c,0,array_size);
+#pragma omp parallel private(lo,hi)
+    {
+      /* each thread flushes the part of the array it wrote */
+      static_range(array_size, &lo, &hi);
+      if(lo < hi) make_durable(dest+lo, hi-lo);
+    }
+    break;
+  case PERSIST_CHUNK:
+#pragma omp parallel for schedule(static) private(lo,hi)
+    for(ch=0; ch<n_chunks; ch++){
+      lo = ch*chunk;
+      hi = lo+chunk < array_size ? lo+chunk : array_size;
+      run_kernel(ks,k,a,b,c,lo,hi);
+      make_durable(dest+lo, hi-lo);
+    }
+    break;
+  case PERSIST_NT:
+    run_kernel(ks,k,a,b,c,0,array_size);
+    if(!on_pmem(dest)) break;
+    if(use_msync){
+      make_durable(dest, array_size);
+    }else{
+#pragma omp parallel private(lo,hi)
+      {
+        /*
+         * the kernels' scalar peel and tail use ordinary stores; they lie
+         * in the first and last line of each thread's part of the array
+         */
+        static_range(array_size, &lo, &hi);
+        if(lo < hi){
+          pmem_flush(dest+lo, sizeof(double));
+          pmem_flush(dest+hi-1, sizeof(double));
+        }
+      }
+      pmem_drain();
+    }
+    break;
+  default:
+    run_kernel(ks,k,a,b,c,0,array_size);
+  }
+
+}
+
+int on_pmem(double *addr){
+
+  return pmem_base != NULL && (char *)addr >= pmem_base && (char *)addr < pmem_base + pmem_len;
+
+}
+
+void make_durable(double *addr, long int n){
+
+  if(use_msync){
+    pmem_msync(addr, n*sizeof(double));
+  }else{
+    pmem_persist(addr, n*sizeof(double));
+  }
+
+}
+
+/*
+ * Validate the arrays after run_kernels by replaying the kernels on scalars,
+ * in the same way as STREAM's checkSTREAMresults.
+ */
+int check_results(double *a, double *b, double *c, long int array_size, int verbose){
+
+  double aj, bj, cj;
+  double a_err = 0.0, b_err = 0.0, c_err = 0.0;
+  double epsilon = 1.e-13;
+  long int j;
+  int errors = 0;
+
+  /* values set by initialise, then one pass of the kernels, which is
+     enough because none of them feeds its output back into its input */
+  aj = 1.0;
+  bj = 2.0;
+  cj = 0.0;
+  bj = aj;
+  cj = SCALAR*aj;
+  cj = bj+aj;
+  cj = aj+bj*SCALAR;
+
+#pragma omp parallel for schedule(static) reduction(+:a_err,b_err,c_err)
+  for (j=0; j<array_size; j++){
+    a_err += fabs(a[j]-aj);
+    b_err += fabs(b[j]-bj);
+    c_err += fabs(c[j]-cj);
+  }
+  a_err = a_err/array_size;
+  b_err = b_err/array_size;
+  c_err = c_err/array_size;
+
+  if (fabs(a_err/aj) > epsilon){
+    printf("Failed validation on array a[], expected %f, average error %e\n", aj, a_err);
+    errors++;
+  }
+  if (fabs(b_err/bj) > epsilon){
+    printf("Failed validation on array b[], expected %f, average error %e\n", bj, b_err);
+    errors++;
+  }
+  if (fabs(c_err/cj) > epsilon){
+    printf("Failed validation on array c[], expected %f, average error %e\n", cj, c_err);
+    errors++;
+  }
+  if (errors == 0 && verbose){
+    printf("Solution validates: average errors a %e b %e c %e (relative to epsilon %e)\n", a_err, b_err, c_err, epsilon);
+  }
+
+  return errors;
+
+}
+
+/*
+ * Measure the best bandwidth of every kernel with the threads on the cpus of
+ * each NUMA node in turn, against DRAM bound to each node with memory and
+ * against the pmem mapping, so local and remote (cross-socket) access can be
+ * compared. At most max_threads threads are used on a node.
+ */
+int numa_matrix(double *pa, double *pb, double *pc, long int array_size, int repeats, int bind, int persist, int max_threads){
+
+  int cpu_nodes[MAX_NODES], mem_nodes[MAX_NODES];
+  int cpus[MAX_CPUS];
+  int n_cpu_nodes, n_mem_nodes, n_cpus, threads;
+  int pmem_node;
+  int s, m, k;
+  int errors = 0;
+  size_t bytes = sizeof(double)*array_size;
+  double *a, *b, *c;
+  double *dram, *pmem;
+  char column[32];
+
+  n_cpu_nodes = numa_nodes(cpu_nodes, 1);
+  n_mem_nodes = numa_nodes(mem_nodes, 0);
+  pmem_node = address_node(pa);
+
+  dram = malloc(sizeof(double)*n_cpu_nodes*n_mem_nodes*NUM_KERNELS);
+  pmem = malloc(sizeof(double)*n_cpu_nodes*NUM_KERNELS);
+  if(dram == NULL || pmem == NULL){
+    fprintf(stderr, "Failed to allocate the NUMA matrix\n");
+    exit(-1);
+  }
+
+  printf("\nNUMA matrix: %d cpu nodes, %d memory nodes, pmem mapping on node %d\n", n_cpu_nodes, n_mem_nodes, pmem_node);
+
+  for(s=0; s<n_cpu_nodes; s++){
+
+    for(k=0; k<NUM_KERNELS; k++){
+      pmem[s*NUM_KERNELS+k] = 0.0;
+      for(m=0; m<n_mem_nodes; m++) dram[(s*n_mem_nodes+m)*NUM_KERNELS+k] = 0.0;
+    }
+
+    n_cpus = node_cpus(cpu_nodes[s], cpus, MAX_CPUS);
+    if(n_cpus == 0) continue;
+    threads = n_cpus < max_threads ? n_cpus : max_threads;
+    omp_set_num_threads(threads);
+    pin_threads(cpus, n_cpus, bind == BIND_SPREAD ? BIND_SPREAD : BIND_CLOSE);
+
+    printf("Running on %d threads on the cpus of node %d\n", threads, cpu_nodes[s]);
+
+    for(m=0; m<n_mem_nodes; m++){
+      a = alloc_array(bytes, POLICY_BIND, mem_nodes[m]);
+      b = alloc_array(bytes, POLICY_BIND, mem_nodes[m]);
+      c = alloc_array(bytes, POLICY_BIND, mem_nodes[m]);
+      if(a == NULL || b == NULL || c == NULL){
+        fprintf(stderr, "Failed to allocate the DRAM arrays on node %d\n", mem_nodes[m]);
+        exit(-1);
+      }
+      initialise(a,b,c,array_size);
+      run_kernels(&plain_kernels,a,b,c,array_size,repeats,0,0,&dram[(s*n_mem_nodes+m)*NUM_KERNELS],NULL);
+      errors += check_results(a,b,c,array_size,0);
+      free_array(a, bytes);
+      free_array(b, bytes);
+      free_array(c, bytes);
+    }
+
+    /* the pmem arrays already hold the values the kernels produce */
+    run_kernels(&plain_kernels,pa,pb,pc,array_size,repeats,persist,0,&pmem[s*NUM_KERNELS],NULL);
+    errors += check_results(pa,pb,pc,array_size,0);
+  }
+
+  /* put the threads back the way they were */
+  omp_set_num_threads(max_threads);
+  n_cpus = process_cpus(cpus, MAX_CPUS);
+  pin_threads(cpus, n_cpus, bind);
+
+  for(k=0; k<NUM_KERNELS; k++){
+    printf("\n--- NUMA bandwidth matrix: %s, best MB/s ------------------------------------------\n", kernel_names[k]);
+    printf("|\n");
+    printf("| %-10s", "cpu node");
+    for(m=0; m<n_mem_nodes; m++){
+      snprintf(column, sizeof(column), "DRAM node %d", mem_nodes[m]);
+      printf(" %14s", column);
+    }
+    snprintf(column, sizeof(column), "PMem node %d", pmem_node);
+    printf(" %14s\n", column);
+    for(s=0; s<n_cpu_nodes; s++){
+      printf("| %-10d", cpu_nodes[s]);
+      for(m=0; m<n_mem_nodes; m++){
+        printf(" %14.3f", dram[(s*n_mem_nodes+m)*NUM_KERNELS+k]);
+      }
+      printf(" %14.3f\n", pmem[s*NUM_KERNELS+k]);
+    }
+    printf("|\n");
+    printf("------------------------------------------------------------------------------------\n");
+  }
+
+  free(dram);
+  free(pmem);
+
+  return errors;
+
+}
+
+/*
+ * Parse a list of read:write mixes such as 3:1,1:1,0:1, or "curve" for the
+ * range from read-only to write-only. Returns the number of mixes, or 0 if
+ * the list is not valid.
+ */
+int parse_mixes(char *list, int *reads, int *writes){
+
+  static char *curve = "1:0,4:1,3:1,2:1,1:1,1:2,1:3,1:4,0:1";
+  char *p, *end;
+  int n = 0;
+
+  if(strcmp(list, "curve") == 0) list = curve;
+
+  for(p = list; *p != '\0' && n < MAX_MIXES; n++){
+    reads[n] = strtol(p, &end, 10);
+    if(end == p || *end != ':') return 0;
+    p = end+1;
+    writes[n] = strtol(p, &end, 10);
+    if(end == p || reads[n] < 0 || writes[n] < 0 || reads[n]+writes[n] == 0) return 0;
+    if(*end == ',') end++;
+    else if(*end != '\0') return 0;
+    p = end;
+  }
+
+  return n;
+
+}
+
+/*
+ * Run each read:write mix over a (read) and b (written) and return the best
+ * bandwidth of each. Returns the number of mixes whose reads did not see
+ * the values the kernels left in a.
+ */
+int run_mixes(double *a, double *b, long int array_size, int repeats, int persist, int *reads, int *writes, int n_mixes, double *best){
+
+  double start, t, sum = 0.0;
+  long int n_read = 0;
+  int i, m;
+  int errors = 0;
+
+  for(m=0; m<n_mixes; m++){
+    best[m] = 0.0;
+    for(i=0; i<repeats; i++){
+      start = seconds();
+      sum = mix_kernel(a,b,array_size,reads[m],writes[m],persist,&n_read);
+      t = seconds() - start;
+      /* the first iteration is a warm-up */
+      if(i > 0 && (double)array_size*sizeof(double)/MB/t > best[m]){
+        best[m] = (double)array_size*sizeof(double)/MB/t;
+      }
+    }
+    /* after the stream kernels every element of a is 1 */
+    if(sum != (double)n_read){
+      printf("Failed validation of the %d:%d mix, read a sum of %f from %ld elements\n", reads[m], writes[m], sum, n_read);
+      errors++;
+    }
+  }
+
+  return errors;
+
+}
+
+/*
+ * Touch every element once, blocks of MIX_BLOCK elements at a time: of every
+ * reads+writes blocks the first reads are summed from a and the rest are
+ * filled in b, so reads:writes is exactly the ratio of bytes. 1:0 is a pure
+ * reduction and 0:1 a pure fill. On pmem each filled block is flushed as it
+ * is written, unless persist is PERSIST_NONE, with one drain at the end.
+ * Returns the sum and the number of elements read.
+ */
+double mix_kernel(double *a, double *b, long int array_size, int reads, int writes, int persist, long int *n_read){
+
+  long int n_blocks = (array_size+MIX_BLOCK-1)/MIX_BLOCK;
+  long int blk, lo, hi, j, count = 0;
+  double sum = 0.0;
+  int durable = persist != PERSIST_NONE && on_pmem(b);
+
+#pragma omp parallel for schedule(static) private(lo,hi,j) reduction(+:sum,count)
+  for(blk=0; blk<n_blocks; blk++){
+    lo = blk*MIX_BLOCK;
+    hi = lo+MIX_BLOCK < array_size ? lo+MIX_BLOCK : array_size;
+    if(blk % (reads+writes) < reads){
+#pragma omp simd reduction(+:sum)
+      for(j=lo; j<hi; j++){
+        sum += a[j];
+      }
+      count += hi-lo;
+    }else{
+      /* the value b already holds, so validation still holds */
+      for(j=lo; j<hi; j++){
+        b[j] = 1.0;
+      }
+      if(durable && !use_msync) pmem_flush(&b[lo], (hi-lo)*sizeof(double));
+    }
+  }
+
+  if(durable){
+    if(use_msync){
+      pmem_msync(b, array_size*sizeof(double));
+    }else{
+      pmem_drain();
+    }
+  }
+
+  *n_read = count;
+  return sum;
+
+}
+
+/* Parse a list of access sizes in bytes, or "all" for 8,64,256,4096. */
+int parse_sizes(char *list, long int *sizes){
+
+  char *p, *end;
+  int n = 0;
+
+  if(strcmp(list, "all") == 0) list = "8,64,256,4096";
+
+  for(p = list; *p != '\0' && n < MAX_ACCESS_SIZES; n++){
+    sizes[n] = strtol(p, &end, 10);
+    if(end == p || sizes[n] < (long int)sizeof(double) || sizes[n] % sizeof(double) != 0) return 0;
+    if(*end == ',') end++;
+    else if(*end != '\0') return 0;
+    p = end;
+  }
+
+  return n;
+
+}
+
+/*
+ * Time reads and writes of each access size and pattern over the n doubles
+ * of buf, keeping the best bandwidth in GB/s (10^9 bytes) of each in
+ * gbs[(size*NUM_PATTERNS+pattern)*2+write]. Returns the number of read
+ * runs that did not see the 1.0 the stream kernels left in the buffer.
+ */
+int run_access(double *buf, long int n, int repeats, long int *sizes, int n_sizes, long int stride, int durable, double *gbs){
+
+  double start, t, sum = 0.0, rate;
+  long int n_read = 0;
+  int s, pattern, write, i, idx;
+  int errors = 0;
+
+  for(s=0; s<n_sizes; s++){
+    for(pattern=0; pattern<NUM_PATTERNS; pattern++){
+      for(write=0; write<2; write++){
+        idx = (s*NUM_PATTERNS+pattern)*2+write;
+        gbs[idx] = 0.0;
+        for(i=0; i<repeats; i++){
+          start = seconds();
+          sum = access_kernel(buf,n,sizes[s]/sizeof(double),stride/sizeof(double),pattern,write,durable,&n_read);
+          t = seconds() - start;
+          /* every slot is accessed once (on average for random) */
+          rate = (double)(n/(sizes[s]/sizeof(double)))*sizes[s]/t/1.e9;
+          if(i > 0 && rate > gbs[idx]) gbs[idx] = rate;
+        }
+        if(!write && sum != (double)n_read){
+          printf("Failed validation of %s %ld byte reads, read a sum of %f from %ld elements\n", pattern_name(pattern), sizes[s], sum, n_read);
+          errors++;
+        }
+      }
+    }
+  }
+
+  return errors;
+
+}
+
+/*
+ * Print the access results for one medium. The efficiency is the share of
+ * the bytes the medium moves that the program asked for, assuming each
+ * access that is not part of a sequential run moves whole granules.
+ */
+void print_access(char *medium, long int granule, long int *sizes, int n_sizes, double *gbs){
+
+  double seq, eff;
+  int s, pattern, write, idx;
+
+  printf("\n--- %s access sizes and patterns, best bandwidth, %ld byte granule\n", medium, granule);
+  printf("--- Timings ------------------------------------------------------------------------\n");
+  printf("|\n");
+  printf("| %8s %-10s %-6s %12s %14s %12s\n", "Bytes", "Pattern", "Op", "GB/s", "% sequential", "Efficiency");
+  for(s=0; s<n_sizes; s++){
+    for(write=0; write<2; write++){
+      seq = gbs[(s*NUM_PATTERNS+PATTERN_SEQUENTIAL)*2+write];
+      for(pattern=0; pattern<NUM_PATTERNS; pattern++){
+        idx = (s*NUM_PATTERNS+pattern)*2+write;
+        eff = pattern == PATTERN_SEQUENTIAL ? 100.0 : 100.0*sizes[s]/(((sizes[s]+granule-1)/granule)*granule);
+        printf("| %8ld %-10s %-6s %12.3f %13.1f%% %11.1f%%\n", sizes[s], pattern_name(pattern), write ? "write" : "read",
+               gbs[idx], 100.0*gbs[idx]/seq, eff);
+      }
+    }
+  }
+  printf("|\n");
+  printf("------------------------------------------------------------------------------------\n");
+
+}
+
+/*
+ * Mark the SIMD kernel sets to run: auto picks the regular and streaming
+ * variants of the widest instruction set the cpu supports, all picks every
+ * supported set, otherwise a comma separated list of set names is given.
+ * Returns non-zero for an unknown or unsupported set.
+ */
+int select_kernel_sets(char *list, int *selected){
+
+  char *names, *tok, *saveptr = NULL;
+  int i, found, isa;
+
+  if(strcmp(list, "auto") == 0 || strcmp(list, "all") == 0){
+    isa = best_isa();
+    for(i=0; i<num_simd_kernel_sets; i++){
+      selected[i] = isa_supported(simd_kernel_sets[i].isa) && (strcmp(list, "all") == 0 || simd_kernel_sets[i].isa == isa);
+    }
+    return 0;
+  }
+
+  names = strdup(list);
+  for(tok = strtok_r(names, ",", &saveptr); tok != NULL; tok = strtok_r(NULL, ",", &saveptr)){
+    found = 0;
+    for(i=0; i<num_simd_kernel_sets; i++){
+      if(strcmp(tok, simd_kernel_sets[i].name) == 0 && isa_supported(simd_kernel_sets[i].isa)){
+        selected[i] = 1;
+        found = 1;
+      }
+    }
+    if(!found){
+      free(names);
+      return 1;
+    }
+  }
+  free(names);
+
   return 0;
 
 }
 
+/*
+ * Run the kernels with each of a, b and c in DRAM or in the pmem mapping,
+ * all eight combinations, to see which arrays are worth keeping in DRAM.
+ * The DRAM arrays use the same placement policy as the memory test.
+ */
+int tier_matrix(double *pa, double *pb, double *pc, long int array_size, int repeats, int persist, int policy, int node){
+
+  double best[8][NUM_KERNELS];
+  double *da, *db, *dc;
+  double *a, *b, *c;
+  size_t bytes = sizeof(double)*array_size;
+  int t, k;
+  int errors = 0;
+
+  da = alloc_array(bytes, policy, node);
+  db = alloc_array(bytes, policy, node);
+  dc = alloc_array(bytes, policy, node);
+  if(da == NULL || db == NULL || dc == NULL){
+    fprintf(stderr, "Failed to allocate the DRAM arrays\n");
+    exit(-1);
+  }
+
+  /* bit 2 places a, bit 1 b and bit 0 c on pmem */
+  for(t=0; t<8; t++){
+    a = t & 4 ? pa : da;
+    b = t & 2 ? pb : db;
+    c = t & 1 ? pc : dc;
+    initialise(a,b,c,array_size);
+    run_kernels(&plain_kernels,a,b,c,array_size,repeats,persist,0,best[t],NULL);
+    errors += check_results(a,b,c,array_size,0);
+  }
+
+  free_array(da, bytes);
+  free_array(db, bytes);
+  free_array(dc, bytes);
+
+  printf("\n--- Placement matrix, best MB/s (D = DRAM, P = PMem) ---------------------------------\n");
+  printf("|\n");
+  printf("| %-8s", "a b c");
+  for(k=0; k<NUM_KERNELS; k++){
+    printf(" %14s", kernel_names[k]);
+  }
+  printf("\n");
+  for(t=0; t<8; t++){
+    printf("| %c %c %c   ", t & 4 ? 'P' : 'D', t & 2 ? 'P' : 'D', t & 1 ? 'P' : 'D');
+    for(k=0; k<NUM_KERNELS; k++){
+      printf(" %14.3f", best[t][k]);
+    }
+    printf("\n");
+  }
+  printf("|\n");
+  printf("------------------------------------------------------------------------------------\n");
+
+  return errors;
+
+}
+
+/*
+ * Run every kernel on DRAM and on pmem for 1 to max_threads threads, with
+ * the threads pinned compact (close) and scatter (spread), writing the best
+ * bandwidth of each run to a CSV file. The DRAM arrays are allocated again
+ * for every run so first touch matches the threads that use them. For each
+ * series the peak, and the fewest threads reaching 95% of it (the knee),
+ * are printed.
+ */
+int thread_sweep(double *pa, double *pb, double *pc, long int array_size, int repeats, int persist, int policy, int node, int bind, int max_threads, char *csv){
+
+  int placements[2] = {BIND_CLOSE, BIND_SPREAD};
+  char *placement_names[2] = {"compact", "scatter"};
+  char *media[2] = {"DRAM", "PMem"};
+  int cpus[MAX_CPUS];
+  int n_cpus;
+  double *best, *result;
+  double *a, *b, *c;
+  double peak;
+  size_t bytes = sizeof(double)*array_size;
+  int m, p, t, k, peak_threads, knee;
+  int errors = 0;
+  FILE *fp;
+
+  fp = fopen(csv, "w");
+  if(fp == NULL){
+    perror("fopen");
+    fprintf(stderr, "Failed to open %s for the thread sweep\n", csv);
+    return 1;
+  }
+  fprintf(fp, "kernel,medium,threads,placement,bandwidth_mb_s\n");
+
+  best = malloc(sizeof(double)*2*2*max_threads*NUM_KERNELS);
+  if(best == NULL){
+    fprintf(stderr, "Failed to allocate the sweep results\n");
+    exit(-1);
+  }
+
+  n_cpus = process_cpus(cpus, MAX_CPUS);
+
+  for(m=0; m<2; m++){
+    for(p=0; p<2; p++){
+      for(t=1; t<=max_threads; t++){
+        omp_set_num_threads(t);
+        pin_threads(cpus, n_cpus, placements[p]);
+        if(m == 0){
+          a = alloc_array(bytes, policy, node);
+          b = alloc_array(bytes, policy, node);
+          c = alloc_array(bytes, policy, node);
+          if(a == NULL || b == NULL || c == NULL){
+            fprintf(stderr, "Failed to allocate the DRAM arrays\n");
+            exit(-1);
+          }
+        }else{
+          a = pa;
+          b = pb;
+          c = pc;
+        }
+        result = &best[((m*2+p)*max_threads+t-1)*NUM_KERNELS];
+        initialise(a,b,c,array_size);
+        run_kernels(&plain_kernels,a,b,c,array_size,repeats,m == 0 ? PERSIST_NONE : persist,0,result,NULL);
+        errors += check_results(a,b,c,array_size,0);
+        if(m == 0){
+          free_array(a, bytes);
+          free_array(b, bytes);
+          free_array(c, bytes);
+        }
+        for(k=0; k<NUM_KERNELS; k++){
+          fprintf(fp, "%s,%s,%d,%s,%.3f\n", kernel_names[k], media[m], t, placement_names[p], result[k]);
+        }
+      }
+    }
+  }
+
+  fclose(fp);
+
+  /* put the threads back the way they were */
+  omp_set_num_threads(max_threads);
+  pin_threads(cpus, n_cpus, bind);
+
+  printf("\n--- Thread sweep, 1 to %d threads, written to %s\n", max_threads, csv);
+  printf("--- Peak and knee (fewest threads reaching 95%% of the peak) ------------------------\n");
+  printf("|\n");
+  printf("| %-8s %-6s %-9s %16s %14s %10s\n", "Kernel", "Medium", "Placement", "Peak MB/s", "Peak threads", "Knee");
+  for(m=0; m<2; m++){
+    for(p=0; p<2; p++){
+      for(k=0; k<NUM_KERNELS; k++){
+        peak = 0.0;
+        peak_threads = 1;
+        for(t=1; t<=max_threads; t++){
+          if(best[((m*2+p)*max_threads+t-1)*NUM_KERNELS+k] > peak){
+            peak = best[((m*2+p)*max_threads+t-1)*NUM_KERNELS+k];
+            peak_threads = t;
+          }
+        }
+        for(knee=1; knee<peak_threads; knee++){
+          if(best[((m*2+p)*max_threads+knee-1)*NUM_KERNELS+k] >= 0.95*peak) break;
+        }
+        printf("| %-8s %-6s %-9s %16.3f %14d %10d\n", kernel_names[k], media[m], placement_names[p], peak, peak_threads, knee);
+      }
+    }
+  }
+  printf("|\n");
+  printf("------------------------------------------------------------------------------------\n");
+
+  free(best);
+
+  return errors;
+
+}
+
+/* Report the page size backing a mapping, and how much of it is huge pages. */
+void print_pages(char *name, void *addr){
+
+  long page_kb, huge_kb;
+
+  if(page_info(addr, &page_kb, &huge_kb) == 0){
+    printf("Pages of %s are %ld kB, %ld kB mapped with huge page entries\n", name, page_kb, huge_kb);
+  }
+
+}
+
+/* Report which NUMA node the start of each array landed on. */
+void print_array_nodes(double *a, double *b, double *c){
+
+  printf("First page of a[] on node %d, b[] on node %d, c[] on node %d\n", address_node(a), address_node(b), address_node(c));
+
+}
+
+void usage(char *name){
+
+  fprintf(stderr, "Usage: %s [options] [array_size repeats path]\n", name);
+  fprintf(stderr, "  -s, --size N          number of doubles in each array (default %d)\n", ARRAY_SIZE);
+  fprintf(stderr, "  -r, --repeats N       number of times each kernel is run (default %d)\n", REPEATS);
+  fprintf(stderr, "  -p, --path DIR/       prefix for the pmem file, e.g. /mnt/pmem0/\n");
+  fprintf(stderr, "  -P, --policy POLICY   DRAM placement: local (first touch), interleave or bind\n");
+  fprintf(stderr, "  -n, --node N          NUMA node for the bind policy (default 0)\n");
+  fprintf(stderr, "  -b, --bind BIND       pin threads: none, close (compact) or spread (scatter)\n");
+  fprintf(stderr, "  -t, --tiers           also place a, b and c in DRAM or pmem independently\n");
+  fprintf(stderr, "  -w, --sweep FILE      sweep 1 to OMP_NUM_THREADS threads, compact and scatter,\n");
+  fprintf(stderr, "                        writing the bandwidth of every run to a CSV file\n");
+  fprintf(stderr, "  -x, --mix LIST        read:write byte mixes, e.g. 1:0,3:1,1:1,0:1, or curve\n");
+  fprintf(stderr, "  -a, --access LIST     sequential, strided and random reads and writes of\n");
+  fprintf(stderr, "                        each size in bytes, e.g. 8,64,256,4096, or all\n");
+  fprintf(stderr, "  -d, --stride B        bytes between strided accesses (default %d)\n", ACCESS_STRIDE);
+  fprintf(stderr, "  -g, --pages PAGES     DRAM array pages: normal (no THP), thp (madvise), 2m or 1g\n");
+  fprintf(stderr, "                        (MAP_HUGETLB, needs reserved huge pages)\n");
+  fprintf(stderr, "  -A, --pmem-align A    map the pmem file 2m or 1g aligned, with MAP_SYNC\n");
+  fprintf(stderr, "  -m, --numa-matrix     also measure every cpu node against every memory node\n");
+  fprintf(stderr, "  -S, --simd SETS       also run hand vectorised kernels: auto, all or a list of\n");
+  fprintf(stderr, "                        sse2, sse2-nt, avx2, avx2-nt, avx512, avx512-nt\n");
+  fprintf(stderr, "  -f, --persist MODE    make the pmem results durable: none, end (default),\n");
+  fprintf(stderr, "                        chunk or nt (streaming stores and a drain)\n");
+  fprintf(stderr, "  -c, --persist-chunk B bytes written between flushes in chunk mode (default %d)\n", PERSIST_CHUNK_BYTES);
+  exit(-1);
+
+}
+
+double seconds(void){
+
+  struct timespec t;
+
+  clock_gettime(CLOCK, &t);
+
+  return t.tv_sec + ((double)t.tv_nsec/1000000000);
+
+}
+
 void initialise(double *a, double *b, double *c, long int array_size){
 
- int j;
-  
-#pragma omp parallel for
+  long int j;
+
+#pragma omp parallel for schedule(static)
   for (j=0; j<array_size; j++){
-    a[j] = 0.0;
+    a[j] = 1.0;
     b[j] = 2.0;
-    c[j] = 1.0;
+    c[j] = 0.0;
   }
 
   return;
@@ -170,51 +1299,51 @@ void initialise(double *a, double *b, double *c, long int array_size){
 }
 
 void copy(double *a, double *b, long int array_size){
-  
-  int j;
-  
-#pragma omp parallel for
+
+  long int j;
+
+#pragma omp parallel for schedule(static)
   for (j=0; j<array_size; j++){
     b[j] = a[j];
   }
   return;
 }
- 
+
 void scale(double *a, double *b, double scalar, long int array_size){
-  
-  int j;
-  
-#pragma omp parallel for
+
+  long int j;
+
+#pragma omp parallel for schedule(static)
   for (j=0; j<array_size; j++){
     b[j] = a[j]*scalar;
   }
-  
+
   return;
-  
+
 }
 
 void add(double *a, double *b, double *c, long int array_size){
-  
-  int j;
-  
-#pragma omp parallel for
+
+  long int j;
+
+#pragma omp parallel for schedule(static)
   for (j=0; j<array_size; j++){
     c[j] = a[j]+b[j];
   }
-  
+
   return;
-  
+
 }
 
 void triadd(double *a, double *b, double *c, double scalar, long int array_size){
-  
-  int j;
-  
-#pragma omp parallel for
+
+  long int j;
+
+#pragma omp parallel for schedule(static)
   for (j=0; j<array_size; j++){
     c[j] = a[j]+b[j]*scalar;
   }
-  
+
   return;
-  
+
 }
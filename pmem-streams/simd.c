@@ -0,0 +1,213 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+#include<stdio.h>
+#include<stdint.h>
+#include<omp.h>
+#include"simd.h"
+
+/*
+ * Each kernel is written once per instruction set with either regular or
+ * non-temporal (streaming) stores. The instruction sets are enabled per
+ * function with target attributes, so every variant is compiled whatever
+ * -march is used, and isa_supported checks CPUID before one is run.
+ *
+ * Every variant peels scalar iterations until the destination is aligned to
+ * the vector width, uses unaligned loads (the sources need not share the
+ * destination's alignment), aligned stores, and a scalar tail. The streaming
+ * variants end with an sfence so the stores are ordered before the kernel
+ * is timed as finished.
+ */
+
+/*
+ * The part of n iterations the calling thread gets, split the same way as
+ * schedule(static) so each thread works on the pages it first touched in
+ * initialise.
+ */
+void static_range(long int n, long int *lo, long int *hi){
+
+  long int threads = omp_get_num_threads();
+  long int thread = omp_get_thread_num();
+  long int chunk = n / threads;
+  long int rem = n % threads;
+
+  *lo = thread * chunk + (thread < rem ? thread : rem);
+  *hi = *lo + chunk + (thread < rem ? 1 : 0);
+
+}
+
+#ifdef __x86_64__
+
+#include<immintrin.h>
+
+typedef void (*range_kernel)(double *, double *, double *, double, long int, long int);
+
+static void run_parallel(range_kernel kernel, double *a, double *b, double *c, double scalar, long int array_size){
+
+#pragma omp parallel
+  {
+    long int lo, hi;
+    static_range(array_size, &lo, &hi);
+    if(lo < hi) kernel(a, b, c, scalar, lo, hi);
+  }
+
+}
+
+#define FENCE_NONE
+#define FENCE_NT _mm_sfence()
+
+#define RANGE_KERNELS(name, isa, vtype, width, loadu, store, set1, vadd, vmul, fence) \
+__attribute__((target(isa))) \
+static void copy_##name##_range(double *a, double *b, double *c, double scalar, long int lo, long int hi){ \
+  long int j = lo; \
+  (void) c; (void) scalar; \
+  for(; j<hi && ((uintptr_t)&b[j] % (width*sizeof(double))) != 0; j++) b[j] = a[j]; \
+  for(; j+width<=hi; j+=width) store(&b[j], loadu(&a[j])); \
+  for(; j<hi; j++) b[j] = a[j]; \
+  fence; \
+} \
+__attribute__((target(isa))) \
+static void scale_##name##_range(double *a, double *b, double *c, double scalar, long int lo, long int hi){ \
+  long int j = lo; \
+  vtype s = set1(scalar); \
+  (void) c; \
+  for(; j<hi && ((uintptr_t)&b[j] % (width*sizeof(double))) != 0; j++) b[j] = a[j]*scalar; \
+  for(; j+width<=hi; j+=width) store(&b[j], vmul(loadu(&a[j]), s)); \
+  for(; j<hi; j++) b[j] = a[j]*scalar; \
+  fence; \
+} \
+__attribute__((target(isa))) \
+static void add_##name##_range(double *a, double *b, double *c, double scalar, long int lo, long int hi){ \
+  long int j = lo; \
+  (void) scalar; \
+  for(; j<hi && ((uintptr_t)&c[j] % (width*sizeof(double))) != 0; j++) c[j] = a[j]+b[j]; \
+  for(; j+width<=hi; j+=width) store(&c[j], vadd(loadu(&a[j]), loadu(&b[j]))); \
+  for(; j<hi; j++) c[j] = a[j]+b[j]; \
+  fence; \
+} \
+__attribute__((target(isa))) \
+static void triadd_##name##_range(double *a, double *b, double *c, double scalar, long int lo, long int hi){ \
+  long int j = lo; \
+  vtype s = set1(scalar); \
+  for(; j<hi && ((uintptr_t)&c[j] % (width*sizeof(double))) != 0; j++) c[j] = a[j]+b[j]*scalar; \
+  for(; j+width<=hi; j+=width) store(&c[j], vadd(loadu(&a[j]), vmul(loadu(&b[j]), s))); \
+  for(; j<hi; j++) c[j] = a[j]+b[j]*scalar; \
+  fence; \
+} \
+static void copy_##name(double *a, double *b, long int array_size){ \
+  run_parallel(copy_##name##_range, a, b, NULL, 0.0, array_size); \
+} \
+static void scale_##name(double *a, double *b, double scalar, long int array_size){ \
+  run_parallel(scale_##name##_range, a, b, NULL, scalar, array_size); \
+} \
+static void add_##name(double *a, double *b, double *c, long int array_size){ \
+  run_parallel(add_##name##_range, a, b, c, 0.0, array_size); \
+} \
+static void triadd_##name(double *a, double *b, double *c, double scalar, long int array_size){ \
+  run_parallel(triadd_##name##_range, a, b, c, scalar, array_size); \
+}
+
+RANGE_KERNELS(sse2, "sse2", __m128d, 2, _mm_loadu_pd, _mm_store_pd, _mm_set1_pd, _mm_add_pd, _mm_mul_pd, FENCE_NONE)
+RANGE_KERNELS(sse2_nt, "sse2", __m128d, 2, _mm_loadu_pd, _mm_stream_pd, _mm_set1_pd, _mm_add_pd, _mm_mul_pd, FENCE_NT)
+RANGE_KERNELS(avx2, "avx2", __m256d, 4, _mm256_loadu_pd, _mm256_store_pd, _mm256_set1_pd, _mm256_add_pd, _mm256_mul_pd, FENCE_NONE)
+RANGE_KERNELS(avx2_nt, "avx2", __m256d, 4, _mm256_loadu_pd, _mm256_stream_pd, _mm256_set1_pd, _mm256_add_pd, _mm256_mul_pd, FENCE_NT)
+RANGE_KERNELS(avx512, "avx512f", __m512d, 8, _mm512_loadu_pd, _mm512_store_pd, _mm512_set1_pd, _mm512_add_pd, _mm512_mul_pd, FENCE_NONE)
+RANGE_KERNELS(avx512_nt, "avx512f", __m512d, 8, _mm512_loadu_pd, _mm512_stream_pd, _mm512_set1_pd, _mm512_add_pd, _mm512_mul_pd, FENCE_NT)
+
+#define KERNEL_SET(label, name, isa, nt) {label, isa, nt, copy_##name, scale_##name, add_##name, triadd_##name}
+
+struct kernel_set simd_kernel_sets[] = {
+  KERNEL_SET("sse2", sse2, ISA_SSE2, 0),
+  KERNEL_SET("sse2-nt", sse2_nt, ISA_SSE2, 1),
+  KERNEL_SET("avx2", avx2, ISA_AVX2, 0),
+  KERNEL_SET("avx2-nt", avx2_nt, ISA_AVX2, 1),
+  KERNEL_SET("avx512", avx512, ISA_AVX512, 0),
+  KERNEL_SET("avx512-nt", avx512_nt, ISA_AVX512, 1)
+};
+
+int num_simd_kernel_sets = sizeof(simd_kernel_sets)/sizeof(simd_kernel_sets[0]);
+
+/* Check CPUID for the instruction set, __builtin_cpu_supports needs a literal. */
+int isa_supported(int isa){
+
+  __builtin_cpu_init();
+
+  switch(isa){
+  case ISA_NONE:
+    return 1;
+  case ISA_SSE2:
+    return __builtin_cpu_supports("sse2");
+  case ISA_AVX2:
+    return __builtin_cpu_supports("avx2");
+  case ISA_AVX512:
+    return __builtin_cpu_supports("avx512f");
+  default:
+    return 0;
+  }
+
+}
+
+#else
+
+/* only the plain C kernels are available off x86 */
+struct kernel_set simd_kernel_sets[1];
+int num_simd_kernel_sets = 0;
+
+int isa_supported(int isa){
+
+  return isa == ISA_NONE;
+
+}
+
+#endif
+
+char *isa_name(int isa){
+
+  switch(isa){
+  case ISA_SSE2:
+    return "sse2";
+  case ISA_AVX2:
+    return "avx2";
+  case ISA_AVX512:
+    return "avx512f";
+  default:
+    return "none";
+  }
+
+}
+
+/* The widest instruction set this cpu supports. */
+int best_isa(void){
+
+  int isa;
+
+  for(isa=ISA_AVX512; isa>ISA_NONE; isa--){
+    if(isa_supported(isa)) return isa;
+  }
+
+  return ISA_NONE;
+
+}
+
+/*
+ * The streaming store variant of the kernels for an instruction set, or of
+ * the widest supported one for ISA_NONE. NULL if there is none.
+ */
+struct kernel_set *streaming_kernels(int isa){
+
+  int i;
+
+  if(isa == ISA_NONE) isa = best_isa();
+
+  for(i=0; i<num_simd_kernel_sets; i++){
+    if(simd_kernel_sets[i].isa == isa && simd_kernel_sets[i].nt && isa_supported(isa)) return &simd_kernel_sets[i];
+  }
+
+  return NULL;
+
+}
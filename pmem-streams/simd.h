@@ -0,0 +1,38 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* Hand vectorised stream kernels for pmem-streams */
+
+/* instruction set a kernel set needs */
+#define ISA_NONE 0
+#define ISA_SSE2 1
+#define ISA_AVX2 2
+#define ISA_AVX512 3
+
+/*
+ * One implementation of the four kernels: copy b=a, scale b=a*scalar,
+ * add c=a+b and triadd c=a+b*scalar.
+ */
+struct kernel_set {
+  char *name;
+  int isa;
+  int nt;
+  void (*copy)(double *, double *, long int);
+  void (*scale)(double *, double *, double, long int);
+  void (*add)(double *, double *, double *, long int);
+  void (*triadd)(double *, double *, double *, double, long int);
+};
+
+extern struct kernel_set simd_kernel_sets[];
+extern int num_simd_kernel_sets;
+
+int isa_supported(int);
+char *isa_name(int);
+int best_isa(void);
+struct kernel_set *streaming_kernels(int);
+void static_range(long int, long int *, long int *);
@@ -0,0 +1,111 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+#define _GNU_SOURCE
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+#include<sys/ioctl.h>
+#include<sys/syscall.h>
+#include<linux/perf_event.h>
+#include<omp.h>
+#include"tlb.h"
+
+/*
+ * Every OpenMP thread opens its own dTLB load and store miss counters with
+ * perf_event_open, as a counter only follows the thread that opened it.
+ * The master thread then starts, stops and reads all of them, so the team
+ * must stay the same size between tlb_open and tlb_close.
+ */
+
+#define MAX_COUNTERS 2048
+
+static int fds[MAX_COUNTERS];
+static int n_fds = 0;
+
+static int open_counter(int op){
+
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB | (op << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* Returns the number of counters opened, 0 if there are none to use. */
+int tlb_open(void){
+
+  n_fds = 0;
+
+#pragma omp parallel
+  {
+    int ops[2] = {PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_OP_WRITE};
+    int i, fd;
+    for(i=0; i<2; i++){
+      /* not every cpu counts store misses, use what there is */
+      fd = open_counter(ops[i]);
+      if(fd < 0) continue;
+#pragma omp critical
+      {
+        if(n_fds < MAX_COUNTERS){
+          fds[n_fds++] = fd;
+        }else{
+          close(fd);
+        }
+      }
+    }
+  }
+
+  return n_fds;
+}
+
+void tlb_start(void){
+
+  int i;
+
+  for(i=0; i<n_fds; i++){
+    ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+    ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+/* Stop counting and return the misses since tlb_start, -1 without counters. */
+long long tlb_stop(void){
+
+  long long count, total = 0;
+  int i;
+
+  if(n_fds == 0) return -1;
+
+  for(i=0; i<n_fds; i++){
+    ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+  }
+  for(i=0; i<n_fds; i++){
+    if(read(fds[i], &count, sizeof(count)) == sizeof(count)) total += count;
+  }
+
+  return total;
+}
+
+void tlb_close(void){
+
+  int i;
+
+  for(i=0; i<n_fds; i++){
+    close(fds[i]);
+  }
+  n_fds = 0;
+}
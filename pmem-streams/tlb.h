@@ -0,0 +1,14 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* dTLB miss counting for pmem-streams */
+
+int tlb_open(void);
+void tlb_start(void);
+long long tlb_stop(void);
+void tlb_close(void);
@@ -98,6 +98,40 @@ double elapsed_time_bw_hr(struct timespec t1, struct timespec t2, int repeats, l
 }
 
 
+/*
+ * STREAM style report for a kernel timed once per iteration. The first
+ * iteration is treated as a warm-up and left out of the best/avg/worst
+ * figures, so repeats must be at least 2.
+ */
+double elapsed_time_stats_hr(double *times, int repeats, double mbytes, char * title){
+
+  double min_time = 0, max_time = 0, avg_time = 0;
+  int i = 0;
+
+  min_time = times[1];
+  max_time = times[1];
+  for (i=1; i<repeats; i++){
+    avg_time += times[i];
+    if (times[i] < min_time) min_time = times[i];
+    if (times[i] > max_time) max_time = times[i];
+  }
+  avg_time = avg_time/(repeats-1);
+
+  printf("\n--- %s\n", title);
+  printf("--- Timings ------------------------------------------------------------------------\n");
+  printf("|\n");
+  for (i=0; i<repeats; i++){
+    printf("| Iteration %3d: %.9lf s   Bandwidth %.3lf MB/s%s\n", i, times[i], mbytes/times[i], i == 0 ? "   (excluded)" : "");
+  }
+  printf("|\n");
+  printf("| Min time: %.9lf s   Avg time: %.9lf s   Max time: %.9lf s\n", min_time, avg_time, max_time);
+  printf("| Best bandwidth %.3lf MB/s   Avg bandwidth %.3lf MB/s   Worst bandwidth %.3lf MB/s\n", mbytes/min_time, mbytes/avg_time, mbytes/max_time);
+  printf("|\n");
+  printf("------------------------------------------------------------------------------------\n");
+
+  return min_time;
+}
+
 double elapsed_time_hr(struct timespec t1, struct timespec t2, char * title){
 
   struct timespec elapsed;
@@ -50,6 +50,7 @@ int pthread_setaffinity_np(pthread_t, size_t, cpu_set_t*);
 #endif
 
 double elapsed_time_bw_hr(struct timespec, struct timespec, int, long int, char *);
+double elapsed_time_stats_hr(double *, int, double, char *);
 double elapsed_time_hr(struct timespec, struct timespec, char *);
 void loop_timer(unsigned long);
 void loop_timer_nop(unsigned long);
@@ -0,0 +1,179 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include "utils.h"
+#include "kernels.h"
+#include "container.h"
+
+/*
+ * Read the containers written by chunk_producer twice, once in full and
+ * once selecting only a sub-region (hyperslab), e.g.
+ *
+ *   ./chunk_consumer 2 /mnt/pmem0/benchmarks 0:64,100:300,0:512 mmap
+ *
+ * The page cache is dropped for the file before each read, and the values
+ * of the selected region are checked against the producer's pattern.
+ */
+
+int parse_region(char *, int, uint64_t *, uint64_t *);
+double timed_read(struct container *, uint64_t *, uint64_t *, double *, uint64_t *);
+void print_read(char *, int, double, uint64_t, uint64_t);
+
+int main(int argc, char **argv){
+
+  struct container c;
+  char name[PATH_MAX] = "";
+  char title[500] = "";
+  char *path;
+  uint64_t dims[CONTAINER_MAX_DIMS], zero[CONTAINER_MAX_DIMS], lo[CONTAINER_MAX_DIMS], hi[CONTAINER_MAX_DIMS], pos[CONTAINER_MAX_DIMS];
+  uint64_t full_elements = 1, region_elements = 1, e = 0, rem = 0, linear = 0, fetched = 0;
+  uint64_t full_fetched = 0, region_fetched = 0;
+  double *full = NULL, *region = NULL;
+  double full_time = 0, region_time = 0, t = 0;
+  int n_files = 0, backend = BACKEND_POSIX, i = 0, d = 0, nd = 0;
+
+  if ( argc < 4 || argc > 5 )  {
+    fprintf(stderr, "ERROR: incorrect usage (number_of_files path region [posix|mmap]), region is lo:hi,lo:hi,...\n");
+    return -10;
+  }
+
+  n_files = atoi(argv[1]);
+  path = argv[2];
+  if ( argc == 5 && (backend = backend_from_name(argv[4])) < 0 )  {
+    fprintf(stderr, "ERROR: unknown backend %s (use posix or mmap).\n", argv[4]);
+    return -10;
+  }
+
+  for ( i = 0 ; i < n_files ; i++ )  {
+    snprintf(name, sizeof(name), "%s/chunkfile_%d", path, i);
+    if ( container_open(&c, name, backend) != 0 ) return 1;
+
+    if ( i == 0 )  {
+      nd = c.hdr.ndims;
+      if ( parse_region(argv[3], nd, lo, hi) != 0 )  {
+        fprintf(stderr, "ERROR: region %s must give lo:hi for each of the %d dimensions\n", argv[3], nd);
+        return -10;
+      }
+      for ( d = 0 ; d < nd ; d++ )  {
+        if ( lo[d] >= hi[d] || hi[d] > c.hdr.dims[d] )  {
+          fprintf(stderr, "ERROR: region %s is outside the %lu elements of dimension %d\n", argv[3], (unsigned long) c.hdr.dims[d], d);
+          return -10;
+        }
+        zero[d] = 0;
+        dims[d] = c.hdr.dims[d];
+        full_elements *= c.hdr.dims[d];
+        region_elements *= hi[d] - lo[d];
+      }
+      full = (double *) malloc(full_elements * sizeof(double));
+      region = (double *) malloc(region_elements * sizeof(double));
+      if ( !full || !region )  {
+        fprintf(stderr, "ERROR: out of memory in chunk_consumer\n");
+        return -1;
+      }
+    }
+
+    if ( c.hdr.ndims != (uint32_t) nd || memcmp(c.hdr.dims, dims, nd * sizeof(uint64_t)) != 0 )  {
+      fprintf(stderr, "ERROR: %s does not have the same dimensions as chunkfile_0\n", name);
+      return -10;
+    }
+
+    if ( (t = timed_read(&c, zero, c.hdr.dims, full, &fetched)) < 0 ) return 1;
+    full_time += t;
+    full_fetched += fetched;
+    if ( (t = timed_read(&c, lo, hi, region, &fetched)) < 0 ) return 1;
+    region_time += t;
+    region_fetched += fetched;
+
+    /* check the selection against the producer's pattern */
+    for ( e = 0 ; e < region_elements ; e++ )  {
+      rem = e;
+      for ( d = nd - 1 ; d >= 0 ; d-- )  {
+        pos[d] = lo[d] + rem % (hi[d] - lo[d]);
+        rem /= hi[d] - lo[d];
+      }
+      linear = 0;
+      for ( d = 0 ; d < nd ; d++ )  {
+        linear = linear * c.hdr.dims[d] + pos[d];
+      }
+      if ( region[e] != (double) linear || full[linear] != (double) linear )  {
+        fprintf(stderr, "ERROR: invalid value at element %lu of %s (found %lf).\n", (unsigned long) linear, name, region[e]);
+        return -11;
+      }
+    }
+
+    container_close(&c);
+  }
+
+  sprintf(title, "Full read of %d containers using %s I/O", n_files, backend_name(backend));
+  print_read(title, n_files, full_time, full_elements * sizeof(double), full_fetched);
+  sprintf(title, "Selective read of %s from %d containers using %s I/O", argv[3], n_files, backend_name(backend));
+  print_read(title, n_files, region_time, region_elements * sizeof(double), region_fetched);
+  printf("Selective read is %.2lf times faster than a full read for %.2lf%% of the data\n",
+         full_time / region_time, 100.0 * region_elements / full_elements);
+
+  free(full);
+  free(region);
+  fflush(stdout);
+  return 0;
+}
+
+/* Parse lo:hi,lo:hi,... with one pair per dimension. */
+int parse_region(char *str, int nd, uint64_t *lo, uint64_t *hi){
+
+  char *p = str, *end = NULL;
+  int d = 0;
+
+  for ( d = 0 ; d < nd ; d++ )  {
+    lo[d] = strtoull(p, &end, 10);
+    if ( end == p || *end != ':' ) return 1;
+    p = end + 1;
+    hi[d] = strtoull(p, &end, 10);
+    if ( end == p ) return 1;
+    if ( d < nd - 1 && *end != ',' ) return 1;
+    p = end + 1;
+  }
+
+  return *end == '\0' ? 0 : 1;
+}
+
+/* Read a region from a cold file, returning the time taken or -1 on error. */
+double timed_read(struct container *c, uint64_t *lo, uint64_t *hi, double *out, uint64_t *fetched){
+
+  struct timespec start, end, elapsed;
+
+  container_drop_cache(c);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if ( container_read_region(c, lo, hi, out, fetched) != 0 ) return -1;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  sub_time_hr(&elapsed, &start, &end);
+  return elapsed.tv_sec + ((double)elapsed.tv_nsec/1000000000);
+}
+
+void print_read(char *title, int n_files, double duration, uint64_t bytes, uint64_t fetched){
+
+  printf("\n--- %s\n", title);
+  printf("--- Timings ------------------------------------------------------------------------\n");
+  printf("|\n");
+  printf("| Duration: %.9lf s   ", duration);
+  printf("Data returned: %.3lf MB   ", (double) n_files * bytes / (1024.0 * 1024.0));
+  printf("Chunks fetched: %.3lf MB\n", (double) fetched / (1024.0 * 1024.0));
+  printf("| Bandwidth (returned) %.3lf MB/s   ", (double) n_files * bytes / (1024.0 * 1024.0) / duration);
+  printf("Bandwidth (fetched) %.3lf MB/s\n", (double) fetched / (1024.0 * 1024.0) / duration);
+  printf("|\n");
+  printf("------------------------------------------------------------------------------------\n");
+}
@@ -0,0 +1,128 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include "utils.h"
+#include "kernels.h"
+#include "container.h"
+
+/*
+ * Write number_of_files chunked containers holding a field of doubles whose
+ * value is the linear index of the element, e.g.
+ *
+ *   ./chunk_producer 512x512x512 64x64x64 2 /mnt/pmem0/benchmarks posix
+ *
+ * Only the chunk writes are timed, not the generation of the chunk data.
+ */
+
+int main(int argc, char **argv){
+
+  struct timespec start, end, elapsed;
+  struct container c;
+  char name[PATH_MAX] = "";
+  char *path;
+  uint64_t dims[CONTAINER_MAX_DIMS], chunk_dims[CONTAINER_MAX_DIMS], origin[CONTAINER_MAX_DIMS], pos[CONTAINER_MAX_DIMS];
+  uint64_t id = 0, e = 0, elements = 1, chunk_elements = 1, linear = 0, rem = 0;
+  double *chunk;
+  double duration = 0;
+  int ndims = 0, n_files = 0, backend = BACKEND_POSIX, i = 0, d = 0, inside = 0;
+
+  if ( argc < 5 || argc > 6 )  {
+    fprintf(stderr, "ERROR: incorrect usage (dims chunk_dims number_of_files path [posix|mmap]).\n");
+    return -10;
+  }
+
+  ndims = parse_dims(argv[1], 'x', dims);
+  if ( ndims < 1 || parse_dims(argv[2], 'x', chunk_dims) != ndims )  {
+    fprintf(stderr, "ERROR: dims and chunk_dims must have the same number (1-%d) of dimensions, e.g. 512x512 64x64.\n", CONTAINER_MAX_DIMS);
+    return -10;
+  }
+  n_files = atoi(argv[3]);
+  path = argv[4];
+  if ( argc == 6 && (backend = backend_from_name(argv[5])) < 0 )  {
+    fprintf(stderr, "ERROR: unknown backend %s (use posix or mmap).\n", argv[5]);
+    return -10;
+  }
+
+  for ( i = 0 ; i < n_files ; i++ )  {
+    snprintf(name, sizeof(name), "%s/chunkfile_%d", path, i);
+    if ( container_create(&c, name, ndims, dims, chunk_dims, backend) != 0 ) return 1;
+
+    elements = 1;
+    chunk_elements = 1;
+    for ( d = 0 ; d < ndims ; d++ )  {
+      elements *= c.hdr.dims[d];
+      chunk_elements *= c.hdr.chunk_dims[d];
+    }
+    chunk = (double *) malloc(c.chunk_bytes);
+    if ( !chunk )  {
+      fprintf(stderr, "ERROR: out of memory in chunk_producer\n");
+      return -1;
+    }
+
+    for ( id = 0 ; id < c.hdr.n_chunks ; id++ )  {
+
+      /* element values are their linear index in the field, padding is zero */
+      container_chunk_origin(&c, id, origin);
+      for ( e = 0 ; e < chunk_elements ; e++ )  {
+        rem = e;
+        for ( d = ndims - 1 ; d >= 0 ; d-- )  {
+          pos[d] = origin[d] + rem % c.hdr.chunk_dims[d];
+          rem /= c.hdr.chunk_dims[d];
+        }
+        linear = 0;
+        inside = 1;
+        for ( d = 0 ; d < ndims ; d++ )  {
+          if ( pos[d] >= c.hdr.dims[d] ) inside = 0;
+          linear = linear * c.hdr.dims[d] + pos[d];
+        }
+        chunk[e] = inside ? (double) linear : 0.0;
+      }
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      if ( container_write_chunk(&c, id, chunk) != 0 )  {
+        fprintf(stderr, "ERROR: unable to write chunk %lu of %s\n", (unsigned long) id, name);
+        return 1;
+      }
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      sub_time_hr(&elapsed, &start, &end);
+      duration += elapsed.tv_sec + ((double)elapsed.tv_nsec/1000000000);
+    }
+
+    /* making the container durable is part of the write */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if ( container_close(&c) != 0 )  {
+      fprintf(stderr, "ERROR: unable to sync %s\n", name);
+      return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sub_time_hr(&elapsed, &start, &end);
+    duration += elapsed.tv_sec + ((double)elapsed.tv_nsec/1000000000);
+
+    free(chunk);
+  }
+
+  printf("\n--- Writing %d containers of %lu elements in chunks of %lu elements using %s I/O\n",
+         n_files, (unsigned long) elements, (unsigned long) chunk_elements, backend_name(backend));
+  printf("--- Timings ------------------------------------------------------------------------\n");
+  printf("|\n");
+  printf("| Duration: %.9lf s   ", duration);
+  printf("Bandwidth %.3lf MB/s\n", (double) n_files * elements * sizeof(double) / (1024.0 * 1024.0) / duration);
+  printf("|\n");
+  printf("------------------------------------------------------------------------------------\n");
+
+  fflush(stdout);
+  return 0;
+}
@@ -20,6 +20,7 @@
 #include <math.h>
 
 #include "utils.h"
+#include "kernels.h"
 
 int main(int argc, char **argv){
   
@@ -68,19 +69,10 @@ int main(int argc, char **argv){
     strcpy(name,path);
     sprintf(name+strlen(name), "_%d", i);
 
-    fd = open(name, O_RDONLY);
-    if (fd < 0) {
-      fprintf(stderr, "ERROR: unable to open test file for reading\n");
-      return 1;
-    }
-    
     /* loop over 1MB chunks */
-    for(j=0; j<rep; j++){
-      read(fd, data, N*size);
+    if ( read_file(name, data, N*size, rep, BACKEND_POSIX) != 0 )  {
+      return 1;
     }
-    
-    fsync(fd);
-    close(fd);
   }
 
   clock_gettime(CLOCK_MONOTONIC, &end);
@@ -0,0 +1,369 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "kernels.h"
+#include "container.h"
+
+static void container_layout(struct container *c){
+
+  uint32_t d = 0;
+
+  c->hdr.n_chunks = 1;
+  c->chunk_bytes = c->hdr.element_size;
+  for ( d = 0 ; d < c->hdr.ndims ; d++ )  {
+    c->chunks_per_dim[d] = (c->hdr.dims[d] + c->hdr.chunk_dims[d] - 1) / c->hdr.chunk_dims[d];
+    c->hdr.n_chunks *= c->chunks_per_dim[d];
+    c->chunk_bytes *= c->hdr.chunk_dims[d];
+  }
+}
+
+static int write_all(int fd, void *buf, size_t len, off_t offset){
+
+  ssize_t n = 0;
+  size_t done = 0;
+
+  while ( done < len )  {
+    n = pwrite(fd, (char *) buf + done, len - done, offset + done);
+    if ( n <= 0 ) return 1;
+    done += n;
+  }
+
+  return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len, off_t offset){
+
+  ssize_t n = 0;
+  size_t done = 0;
+
+  while ( done < len )  {
+    n = pread(fd, (char *) buf + done, len - done, offset + done);
+    if ( n <= 0 ) return 1;
+    done += n;
+  }
+
+  return 0;
+}
+
+/*
+ * Create a container for a field of dims doubles cut into chunk_dims chunks.
+ * The header and index are written straight away, the chunks are then
+ * filled in with container_write_chunk.
+ */
+int container_create(struct container *c, char *name, int ndims, uint64_t *dims, uint64_t *chunk_dims, int backend){
+
+  size_t index_bytes = 0;
+  uint64_t i = 0;
+  int d = 0;
+
+  if ( ndims < 1 || ndims > CONTAINER_MAX_DIMS )  {
+    fprintf(stderr, "ERROR: containers have between 1 and %d dimensions\n", CONTAINER_MAX_DIMS);
+    return 1;
+  }
+
+  memset(c, 0, sizeof(struct container));
+  memcpy(c->hdr.magic, CONTAINER_MAGIC, sizeof(c->hdr.magic));
+  c->hdr.version = CONTAINER_VERSION;
+  c->hdr.ndims = ndims;
+  c->hdr.element_size = sizeof(double);
+  for ( d = 0 ; d < ndims ; d++ )  {
+    if ( dims[d] == 0 || chunk_dims[d] == 0 )  {
+      fprintf(stderr, "ERROR: field and chunk dimensions must be positive\n");
+      return 1;
+    }
+    c->hdr.dims[d] = dims[d];
+    c->hdr.chunk_dims[d] = chunk_dims[d] < dims[d] ? chunk_dims[d] : dims[d];
+  }
+  container_layout(c);
+  c->hdr.index_offset = sizeof(struct container_header);
+  c->backend = backend;
+  c->writable = 1;
+
+  index_bytes = c->hdr.n_chunks * sizeof(struct chunk_entry);
+  c->index = (struct chunk_entry *) malloc(index_bytes);
+  if ( !c->index )  {
+    fprintf(stderr, "ERROR: out of memory creating container %s\n", name);
+    return 1;
+  }
+  for ( i = 0 ; i < c->hdr.n_chunks ; i++ )  {
+    c->index[i].offset = c->hdr.index_offset + index_bytes + i * c->chunk_bytes;
+    c->index[i].bytes = c->chunk_bytes;
+  }
+  c->map_len = c->hdr.index_offset + index_bytes + c->hdr.n_chunks * c->chunk_bytes;
+
+  c->fd = open(name, O_CREAT|O_RDWR|O_TRUNC, 0644);
+  if ( c->fd < 0 )  {
+    fprintf(stderr, "ERROR: unable to open %s for writing\n", name);
+    free(c->index);
+    return 1;
+  }
+  if ( ftruncate(c->fd, c->map_len) != 0 )  {
+    fprintf(stderr, "ERROR: unable to size container %s\n", name);
+    container_close(c);
+    return 1;
+  }
+
+  if ( backend == BACKEND_MMAP )  {
+    c->map = mmap(NULL, c->map_len, PROT_READ|PROT_WRITE, MAP_SHARED, c->fd, 0);
+    if ( c->map == MAP_FAILED )  {
+      fprintf(stderr, "ERROR: unable to map container %s\n", name);
+      c->map = NULL;
+      container_close(c);
+      return 1;
+    }
+    memcpy(c->map, &c->hdr, sizeof(struct container_header));
+    memcpy(c->map + c->hdr.index_offset, c->index, index_bytes);
+  }else{
+    if ( write_all(c->fd, &c->hdr, sizeof(struct container_header), 0) != 0 ||
+         write_all(c->fd, c->index, index_bytes, c->hdr.index_offset) != 0 )  {
+      fprintf(stderr, "ERROR: unable to write header of container %s\n", name);
+      container_close(c);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Store one full chunk (chunk_dims elements, row-major) as chunk number id. */
+int container_write_chunk(struct container *c, uint64_t id, double *chunk){
+
+  if ( id >= c->hdr.n_chunks ) return 1;
+
+  if ( c->backend == BACKEND_MMAP )  {
+    memcpy(c->map + c->index[id].offset, chunk, c->index[id].bytes);
+    return 0;
+  }
+
+  return write_all(c->fd, chunk, c->index[id].bytes, c->index[id].offset);
+}
+
+/* Open an existing container and load its header and chunk index. */
+int container_open(struct container *c, char *name, int backend){
+
+  size_t index_bytes = 0;
+  struct stat sb;
+  uint64_t limit = 0, bytes = 0, chunks = 0, per_dim = 0, i = 0;
+  uint32_t d = 0;
+
+  memset(c, 0, sizeof(struct container));
+  c->backend = backend;
+
+  c->fd = open(name, O_RDONLY);
+  if ( c->fd < 0 )  {
+    fprintf(stderr, "ERROR: unable to open %s for reading\n", name);
+    return 1;
+  }
+  if ( fstat(c->fd, &sb) != 0 || read_all(c->fd, &c->hdr, sizeof(struct container_header), 0) != 0 ||
+       memcmp(c->hdr.magic, CONTAINER_MAGIC, sizeof(c->hdr.magic)) != 0 || c->hdr.version != CONTAINER_VERSION ||
+       c->hdr.ndims < 1 || c->hdr.ndims > CONTAINER_MAX_DIMS || c->hdr.element_size != sizeof(double) )  {
+    fprintf(stderr, "ERROR: %s is not a version %d container\n", name, CONTAINER_VERSION);
+    container_close(c);
+    return 1;
+  }
+
+  /*
+   * Don't trust the file: the chunk shape must fit the field, and neither a
+   * chunk nor the index can be bigger than the file (which also keeps the
+   * sizes below from overflowing).
+   */
+  limit = sb.st_size;
+  bytes = c->hdr.element_size;
+  chunks = 1;
+  for ( d = 0 ; d < c->hdr.ndims ; d++ )  {
+    if ( c->hdr.chunk_dims[d] == 0 || c->hdr.chunk_dims[d] > c->hdr.dims[d] ) break;
+    per_dim = (c->hdr.dims[d] - 1) / c->hdr.chunk_dims[d] + 1;
+    if ( bytes > limit / c->hdr.chunk_dims[d] || chunks > limit / per_dim ) break;
+    bytes *= c->hdr.chunk_dims[d];
+    chunks *= per_dim;
+  }
+  if ( d < c->hdr.ndims || chunks > limit / sizeof(struct chunk_entry) ||
+       c->hdr.index_offset > limit - chunks * sizeof(struct chunk_entry) )  {
+    fprintf(stderr, "ERROR: %s has a corrupt header\n", name);
+    container_close(c);
+    return 1;
+  }
+  container_layout(c);
+
+  index_bytes = c->hdr.n_chunks * sizeof(struct chunk_entry);
+  c->index = (struct chunk_entry *) malloc(index_bytes);
+  c->scratch = (char *) malloc(c->chunk_bytes);
+  if ( !c->index || !c->scratch || read_all(c->fd, c->index, index_bytes, c->hdr.index_offset) != 0 )  {
+    fprintf(stderr, "ERROR: unable to read the chunk index of %s\n", name);
+    container_close(c);
+    return 1;
+  }
+  for ( i = 0 ; i < c->hdr.n_chunks ; i++ )  {
+    if ( c->index[i].bytes != c->chunk_bytes || c->index[i].offset > limit - c->index[i].bytes )  {
+      fprintf(stderr, "ERROR: chunk %lu of %s lies outside the file\n", (unsigned long) i, name);
+      container_close(c);
+      return 1;
+    }
+  }
+
+  if ( backend == BACKEND_MMAP )  {
+    c->map_len = sb.st_size;
+    c->map = mmap(NULL, c->map_len, PROT_READ, MAP_SHARED, c->fd, 0);
+    if ( c->map == MAP_FAILED )  {
+      fprintf(stderr, "ERROR: unable to map container %s\n", name);
+      c->map = NULL;
+      container_close(c);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Coordinates of the first element of chunk id. */
+void container_chunk_origin(struct container *c, uint64_t id, uint64_t *origin){
+
+  int d = 0;
+
+  for ( d = c->hdr.ndims - 1 ; d >= 0 ; d-- )  {
+    origin[d] = (id % c->chunks_per_dim[d]) * c->hdr.chunk_dims[d];
+    id /= c->chunks_per_dim[d];
+  }
+}
+
+/*
+ * Read the region lo[d] <= x[d] < hi[d] into out (row-major, hi-lo wide in
+ * each dimension), fetching only the chunks that intersect it. The number of
+ * bytes fetched from the file is returned in fetched.
+ */
+int container_read_region(struct container *c, uint64_t *lo, uint64_t *hi, double *out, uint64_t *fetched){
+
+  uint64_t clo[CONTAINER_MAX_DIMS], chi[CONTAINER_MAX_DIMS], cidx[CONTAINER_MAX_DIMS];
+  uint64_t origin[CONTAINER_MAX_DIMS], blo[CONTAINER_MAX_DIMS], bhi[CONTAINER_MAX_DIMS], pos[CONTAINER_MAX_DIMS];
+  uint64_t extent[CONTAINER_MAX_DIMS];
+  uint64_t id = 0, src = 0, dst = 0, run = 0;
+  int nd = c->hdr.ndims, d = 0;
+  char *chunk = NULL;
+
+  *fetched = 0;
+  for ( d = 0 ; d < nd ; d++ )  {
+    if ( lo[d] >= hi[d] || hi[d] > c->hdr.dims[d] )  {
+      fprintf(stderr, "ERROR: region is outside the field in dimension %d\n", d);
+      return 1;
+    }
+    extent[d] = hi[d] - lo[d];
+    clo[d] = lo[d] / c->hdr.chunk_dims[d];
+    chi[d] = (hi[d] - 1) / c->hdr.chunk_dims[d];
+    cidx[d] = clo[d];
+  }
+
+  /* visit every intersecting chunk */
+  while ( 1 )  {
+    id = 0;
+    for ( d = 0 ; d < nd ; d++ )  {
+      id = id * c->chunks_per_dim[d] + cidx[d];
+    }
+
+    if ( c->backend == BACKEND_MMAP )  {
+      chunk = c->map + c->index[id].offset;
+    }else{
+      if ( read_all(c->fd, c->scratch, c->index[id].bytes, c->index[id].offset) != 0 )  {
+        fprintf(stderr, "ERROR: unable to read chunk %lu\n", (unsigned long) id);
+        return 1;
+      }
+      chunk = c->scratch;
+    }
+    *fetched += c->index[id].bytes;
+
+    /* intersection of the chunk with the region */
+    container_chunk_origin(c, id, origin);
+    for ( d = 0 ; d < nd ; d++ )  {
+      blo[d] = lo[d] > origin[d] ? lo[d] : origin[d];
+      bhi[d] = hi[d] < origin[d] + c->hdr.chunk_dims[d] ? hi[d] : origin[d] + c->hdr.chunk_dims[d];
+      pos[d] = blo[d];
+    }
+    run = (bhi[nd-1] - blo[nd-1]) * sizeof(double);
+
+    /* copy contiguous runs along the last dimension */
+    while ( 1 )  {
+      src = 0;
+      dst = 0;
+      for ( d = 0 ; d < nd ; d++ )  {
+        src = src * c->hdr.chunk_dims[d] + (pos[d] - origin[d]);
+        dst = dst * extent[d] + (pos[d] - lo[d]);
+      }
+      memcpy(&out[dst], chunk + src * sizeof(double), run);
+
+      for ( d = nd - 2 ; d >= 0 ; d-- )  {
+        if ( ++pos[d] < bhi[d] ) break;
+        pos[d] = blo[d];
+      }
+      if ( d < 0 ) break;
+    }
+
+    for ( d = nd - 1 ; d >= 0 ; d-- )  {
+      if ( ++cidx[d] <= chi[d] ) break;
+      cidx[d] = clo[d];
+    }
+    if ( d < 0 ) break;
+  }
+
+  return 0;
+}
+
+/* Ask the kernel to drop any cached pages of the container file. */
+void container_drop_cache(struct container *c){
+
+  if ( c->map ) madvise(c->map, c->map_len, MADV_DONTNEED);
+  posix_fadvise(c->fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+/* Make a written container durable and release everything. */
+int container_close(struct container *c){
+
+  int ret = 0;
+
+  if ( c->map )  {
+    if ( c->writable ) ret |= msync(c->map, c->map_len, MS_SYNC);
+    munmap(c->map, c->map_len);
+  }
+  if ( c->fd >= 0 )  {
+    if ( c->writable ) ret |= fsync(c->fd);
+    close(c->fd);
+  }
+  free(c->index);
+  free(c->scratch);
+  memset(c, 0, sizeof(struct container));
+  c->fd = -1;
+
+  return ret;
+}
+
+/* Parse a list such as 512x512x64 into dims, returning how many were found. */
+int parse_dims(char *str, char sep, uint64_t *dims){
+
+  char *p = str, *end = NULL;
+  int n = 0;
+
+  while ( n < CONTAINER_MAX_DIMS )  {
+    dims[n] = strtoull(p, &end, 10);
+    if ( end == p ) return -1;
+    n++;
+    if ( *end == '\0' ) return n;
+    if ( *end != sep ) return -1;
+    p = end + 1;
+  }
+
+  return -1;
+}
@@ -0,0 +1,63 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/*
+ * Chunked, self-describing container for N-D fields of doubles:
+ *
+ *   header | chunk index | chunk 0 | chunk 1 | ...
+ *
+ * The field is cut into fixed-size chunks (edge chunks are padded so every
+ * chunk has the same size) stored in row-major chunk order, each chunk being
+ * row-major internally. The index records where every chunk lives, so a
+ * reader can fetch only the chunks that intersect the region it wants.
+ */
+
+#include <stdint.h>
+
+#define CONTAINER_MAGIC "NGIOCHK1"
+#define CONTAINER_VERSION 1
+#define CONTAINER_MAX_DIMS 4
+
+struct container_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t ndims;
+  uint32_t element_size;
+  uint32_t pad;
+  uint64_t dims[CONTAINER_MAX_DIMS];
+  uint64_t chunk_dims[CONTAINER_MAX_DIMS];
+  uint64_t n_chunks;
+  uint64_t index_offset;
+};
+
+struct chunk_entry {
+  uint64_t offset;
+  uint64_t bytes;
+};
+
+struct container {
+  struct container_header hdr;
+  struct chunk_entry *index;
+  uint64_t chunks_per_dim[CONTAINER_MAX_DIMS];
+  uint64_t chunk_bytes;
+  int fd;
+  int backend;
+  int writable;
+  char *map;
+  size_t map_len;
+  char *scratch;
+};
+
+int container_create(struct container *, char *, int, uint64_t *, uint64_t *, int);
+int container_write_chunk(struct container *, uint64_t, double *);
+int container_open(struct container *, char *, int);
+int container_read_region(struct container *, uint64_t *, uint64_t *, double *, uint64_t *);
+void container_chunk_origin(struct container *, uint64_t, uint64_t *);
+void container_drop_cache(struct container *);
+int container_close(struct container *);
+int parse_dims(char *, char, uint64_t *);
@@ -0,0 +1,484 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "kernels.h"
+
+/*
+ * Workflow driver: runs a DAG of producer/consumer stages, e.g.
+ *
+ *   ./dag pipeline.dag /mnt/pmem0/benchmarks mmap
+ *
+ * Each stage reads every file written by the stages it depends on and then
+ * writes its own files, sharing the files between its threads. A stage is
+ * started as soon as all of its dependencies have finished, so independent
+ * stages run concurrently. See pipeline.dag for the description format.
+ */
+
+#define MAX_STAGES 64
+#define MAX_NAME 64
+#define MAX_LINE 1024
+#define MB 1048576
+
+struct stage {
+  char name[MAX_NAME];
+  char pattern[MAX_NAME];
+  char dep_names[MAX_LINE];
+  int n_files;
+  int size_mb;
+  int threads;
+  int n_deps;
+  int deps[MAX_STAGES];
+
+  /* filled in while running, seconds since the start of the workflow */
+  int done;
+  int failed;
+  double ready, start, end;
+  double busy, idle;      /* thread-seconds working, and waiting for the stage's slowest thread */
+  pthread_t launcher;
+
+  /* critical path through this stage */
+  double path_length;
+  int path_prev;
+};
+
+struct stage_worker {
+  pthread_t thread;
+  struct stage *stage;
+  int id;
+  int failed;
+  double end;
+};
+
+static struct stage stages[MAX_STAGES];
+static int n_stages = 0;
+static char *path;
+static int backend = BACKEND_POSIX;
+static struct timespec t0;
+static pthread_mutex_t dag_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dag_cond = PTHREAD_COND_INITIALIZER;
+
+int parse_dag(char *);
+int resolve_deps(void);
+int order_stages(int *);
+void critical_path(int *);
+double now(void);
+void stage_file(struct stage *, int, char *, int);
+void *stage_launcher(void *);
+void *stage_worker(void *);
+
+int main(int argc, char **argv){
+
+  int order[MAX_STAGES];
+  int i = 0, s = 0, d = 0, last = -1, failed = 0, threads = 0;
+  int chain[MAX_STAGES], chain_len = 0;
+  double makespan = 0, durations = 0, busy = 0, idle = 0, mb = 0, total_mb = 0;
+
+  if ( argc < 3 || argc > 4 )  {
+    fprintf(stderr, "ERROR: incorrect usage (dag_file path [posix|mmap]).\n");
+    return -10;
+  }
+
+  path = argv[2];
+  if ( argc == 4 )  {
+    backend = backend_from_name(argv[3]);
+    if ( backend < 0 )  {
+      fprintf(stderr, "ERROR: unknown backend %s (use posix or mmap).\n", argv[3]);
+      return -10;
+    }
+  }
+
+  if ( parse_dag(argv[1]) != 0 || resolve_deps() != 0 || order_stages(order) != 0 )  {
+    return -10;
+  }
+
+  printf("Running workflow %s with %d stages in directory %s using %s I/O\n", argv[1], n_stages, path, backend_name(backend));
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  for ( s = 0 ; s < n_stages ; s++ )  {
+    if ( pthread_create(&stages[s].launcher, NULL, stage_launcher, &stages[s]) != 0 )  {
+      fprintf(stderr, "ERROR: unable to create launcher for stage %s\n", stages[s].name);
+      exit(-102);
+    }
+  }
+  for ( s = 0 ; s < n_stages ; s++ )  {
+    pthread_join(stages[s].launcher, NULL);
+    failed |= stages[s].failed;
+  }
+
+  makespan = now();
+  critical_path(order);
+
+  printf("\n--- Workflow stages ----------------------------------------------------------------\n");
+  printf("|\n");
+  printf("| %-16s %8s %12s %12s %12s %12s %12s %12s\n", "Stage", "Threads", "Ready (s)", "Start (s)", "End (s)", "Duration (s)", "Idle (s)", "MB/s");
+  for ( i = 0 ; i < n_stages ; i++ )  {
+    s = order[i];
+    mb = (double) stages[s].n_files * stages[s].size_mb;
+    for ( d = 0 ; d < stages[s].n_deps ; d++ )  {
+      mb += (double) stages[stages[s].deps[d]].n_files * stages[stages[s].deps[d]].size_mb;
+    }
+    total_mb += mb;
+    durations += stages[s].end - stages[s].start;
+    busy += stages[s].busy;
+    threads += stages[s].threads;
+    printf("| %-16s %8d %12.6lf %12.6lf %12.6lf %12.6lf %12.6lf %12.3lf\n", stages[s].name, stages[s].threads,
+           stages[s].ready, stages[s].start, stages[s].end, stages[s].end - stages[s].start, stages[s].idle,
+           mb / (stages[s].end - stages[s].start));
+  }
+
+  /* walk back along the critical path from the stage that finishes it */
+  last = order[0];
+  for ( s = 0 ; s < n_stages ; s++ )  {
+    if ( stages[s].path_length > stages[last].path_length ) last = s;
+  }
+  for ( s = last ; s >= 0 ; s = stages[s].path_prev )  {
+    chain[chain_len++] = s;
+  }
+
+  /* every thread of every stage counted over the whole workflow, running or not */
+  idle = makespan * threads - busy;
+
+  printf("|\n");
+  printf("| Idle is thread-seconds a stage's threads spent finished, waiting for its slowest thread.\n");
+  printf("| Makespan: %.9lf s   Sum of stage durations: %.9lf s\n", makespan, durations);
+  printf("| Workflow thread-seconds: %.9lf busy, %.9lf idle (%.1lf%% of makespan x %d threads)\n", busy, idle,
+         100.0 * idle / (makespan * threads), threads);
+  printf("| Critical path length: %.9lf s (%.1lf%% of makespan)\n", stages[last].path_length, 100.0 * stages[last].path_length / makespan);
+  printf("| Critical path: ");
+  for ( i = chain_len - 1 ; i >= 0 ; i-- )  {
+    printf("%s%s", stages[chain[i]].name, i > 0 ? " -> " : "\n");
+  }
+  printf("| Aggregate bandwidth: %.3lf MB/s\n", total_mb / makespan);
+  printf("|\n");
+  printf("------------------------------------------------------------------------------------\n");
+
+  /* remove the files written by the workflow */
+  for ( s = 0 ; s < n_stages ; s++ )  {
+    char name[PATH_MAX];
+    for ( i = 0 ; i < stages[s].n_files ; i++ )  {
+      stage_file(&stages[s], i, name, sizeof(name));
+      unlink(name);
+    }
+  }
+
+  fflush(stdout);
+  return failed ? 1 : 0;
+}
+
+/*
+ * Read the DAG description. Each non-comment line describes one stage:
+ *
+ *   stage <name> <file pattern> <files> <MB per file> <threads> <deps|->
+ *
+ * where deps is a comma separated list of stage names.
+ */
+int parse_dag(char *filename){
+
+  FILE *fp;
+  char line[MAX_LINE];
+  char keyword[MAX_NAME];
+  struct stage *st;
+  int lineno = 0, n = 0, s = 0;
+
+  fp = fopen(filename, "r");
+  if ( !fp )  {
+    fprintf(stderr, "ERROR: unable to open workflow description %s\n", filename);
+    return 1;
+  }
+
+  while ( fgets(line, sizeof(line), fp) )  {
+    lineno++;
+    if ( sscanf(line, "%63s", keyword) != 1 || keyword[0] == '#' ) continue;
+
+    if ( strcmp(keyword, "stage") != 0 )  {
+      fprintf(stderr, "ERROR: %s:%d: unknown keyword %s\n", filename, lineno, keyword);
+      fclose(fp);
+      return 1;
+    }
+    if ( n_stages == MAX_STAGES )  {
+      fprintf(stderr, "ERROR: %s:%d: too many stages (maximum %d)\n", filename, lineno, MAX_STAGES);
+      fclose(fp);
+      return 1;
+    }
+
+    st = &stages[n_stages];
+    memset(st, 0, sizeof(struct stage));
+    n = sscanf(line, "%*s %63s %63s %d %d %d %1023s", st->name, st->pattern, &st->n_files, &st->size_mb, &st->threads, st->dep_names);
+    if ( n != 6 || st->n_files < 0 || st->size_mb < 0 || st->threads < 1 )  {
+      fprintf(stderr, "ERROR: %s:%d: expected stage name pattern files size_mb threads deps\n", filename, lineno);
+      fclose(fp);
+      return 1;
+    }
+    if ( strstr(st->pattern, "%d") == NULL || strchr(strstr(st->pattern, "%d") + 2, '%') != NULL )  {
+      fprintf(stderr, "ERROR: %s:%d: file pattern %s must contain a single %%d\n", filename, lineno, st->pattern);
+      fclose(fp);
+      return 1;
+    }
+    /* stages sharing a name or a pattern would be confused or overwrite each other's files */
+    for ( s = 0 ; s < n_stages ; s++ )  {
+      if ( strcmp(stages[s].name, st->name) == 0 )  {
+        fprintf(stderr, "ERROR: %s:%d: duplicate stage name %s\n", filename, lineno, st->name);
+        fclose(fp);
+        return 1;
+      }
+      if ( strcmp(stages[s].pattern, st->pattern) == 0 )  {
+        fprintf(stderr, "ERROR: %s:%d: stage %s uses the file pattern %s of stage %s\n", filename, lineno, st->name, st->pattern, stages[s].name);
+        fclose(fp);
+        return 1;
+      }
+    }
+    st->path_prev = -1;
+    n_stages++;
+  }
+
+  fclose(fp);
+
+  if ( n_stages == 0 )  {
+    fprintf(stderr, "ERROR: no stages found in %s\n", filename);
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Turn the dependency names into stage indices. */
+int resolve_deps(void){
+
+  char *tok, *saveptr = NULL;
+  int s = 0, d = 0;
+
+  for ( s = 0 ; s < n_stages ; s++ )  {
+    if ( strcmp(stages[s].dep_names, "-") == 0 ) continue;
+
+    for ( tok = strtok_r(stages[s].dep_names, ",", &saveptr) ; tok ; tok = strtok_r(NULL, ",", &saveptr) )  {
+      for ( d = 0 ; d < n_stages ; d++ )  {
+        if ( strcmp(stages[d].name, tok) == 0 ) break;
+      }
+      if ( d == n_stages )  {
+        fprintf(stderr, "ERROR: stage %s depends on unknown stage %s\n", stages[s].name, tok);
+        return 1;
+      }
+      if ( d == s )  {
+        fprintf(stderr, "ERROR: stage %s depends on itself\n", stages[s].name);
+        return 1;
+      }
+      stages[s].deps[stages[s].n_deps++] = d;
+    }
+  }
+
+  return 0;
+}
+
+/* Topologically sort the stages into order, failing if there is a cycle. */
+int order_stages(int *order){
+
+  int placed[MAX_STAGES], seen[MAX_STAGES], cycle[MAX_STAGES];
+  int n = 0, s = 0, d = 0, ready = 0, progress = 1;
+
+  memset(placed, 0, sizeof(placed));
+
+  while ( n < n_stages && progress )  {
+    progress = 0;
+    for ( s = 0 ; s < n_stages ; s++ )  {
+      if ( placed[s] ) continue;
+      ready = 1;
+      for ( d = 0 ; d < stages[s].n_deps ; d++ )  {
+        if ( !placed[stages[s].deps[d]] ) ready = 0;
+      }
+      if ( ready )  {
+        order[n++] = s;
+        placed[s] = 1;
+        progress = 1;
+      }
+    }
+  }
+
+  if ( n < n_stages )  {
+    /*
+     * every stage left has a dependency that is also left, so following
+     * them from any of these stages must come back round to one of them
+     */
+    memset(seen, 0, sizeof(seen));
+    for ( s = 0 ; placed[s] ; s++ );
+    while ( !seen[s] )  {
+      seen[s] = 1;
+      for ( d = 0 ; placed[stages[s].deps[d]] ; d++ );
+      stages[s].path_prev = stages[s].deps[d];
+      s = stages[s].deps[d];
+    }
+    /* the walk went against the data flow, print the cycle the other way round */
+    n = 0;
+    d = s;
+    do  {
+      cycle[n++] = d;
+      d = stages[d].path_prev;
+    } while ( d != s );
+    fprintf(stderr, "ERROR: the workflow contains a dependency cycle: %s", stages[s].name);
+    while ( n > 0 ) fprintf(stderr, " -> %s", stages[cycle[--n]].name);
+    fprintf(stderr, "\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Longest chain of measured stage durations ending at each stage. */
+void critical_path(int *order){
+
+  int i = 0, s = 0, d = 0, dep = 0;
+
+  for ( i = 0 ; i < n_stages ; i++ )  {
+    s = order[i];
+    stages[s].path_prev = -1;
+    stages[s].path_length = 0;
+    for ( d = 0 ; d < stages[s].n_deps ; d++ )  {
+      dep = stages[s].deps[d];
+      if ( stages[dep].path_length > stages[s].path_length )  {
+        stages[s].path_length = stages[dep].path_length;
+        stages[s].path_prev = dep;
+      }
+    }
+    stages[s].path_length += stages[s].end - stages[s].start;
+  }
+}
+
+/* Seconds since the start of the workflow. */
+double now(void){
+
+  struct timespec t, elapsed;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  sub_time_hr(&elapsed, &t0, &t);
+
+  return elapsed.tv_sec + ((double)elapsed.tv_nsec/1000000000);
+}
+
+void stage_file(struct stage *st, int i, char *name, int len){
+
+  char file[MAX_NAME + 16];
+
+  snprintf(file, sizeof(file), st->pattern, i);
+  snprintf(name, len, "%s/%s", path, file);
+}
+
+/* Wait for the stage's dependencies to finish, then run it on its threads. */
+void *stage_launcher(void *arg){
+
+  struct stage *st = (struct stage *) arg;
+  struct stage_worker *workers = NULL;
+  int d = 0, t = 0, waiting = 1, failed = 0;
+
+  pthread_mutex_lock(&dag_mutex);
+  while ( waiting )  {
+    waiting = 0;
+    for ( d = 0 ; d < st->n_deps ; d++ )  {
+      if ( !stages[st->deps[d]].done ) waiting = 1;
+      if ( stages[st->deps[d]].failed ) failed = 1;
+    }
+    if ( waiting ) pthread_cond_wait(&dag_cond, &dag_mutex);
+  }
+  pthread_mutex_unlock(&dag_mutex);
+
+  for ( d = 0 ; d < st->n_deps ; d++ )  {
+    if ( stages[st->deps[d]].end > st->ready ) st->ready = stages[st->deps[d]].end;
+  }
+  st->start = now();
+
+  if ( !failed )  {
+    workers = (struct stage_worker *) malloc(st->threads * sizeof(struct stage_worker));
+    if ( !workers )  {
+      fprintf(stderr, "ERROR: out of memory in stage %s\n", st->name);
+      exit(-1);
+    }
+    for ( t = 0 ; t < st->threads ; t++ )  {
+      workers[t].stage = st;
+      workers[t].id = t;
+      workers[t].failed = 0;
+      if ( pthread_create(&workers[t].thread, NULL, stage_worker, &workers[t]) != 0 )  {
+        fprintf(stderr, "ERROR: unable to create thread %d of stage %s\n", t, st->name);
+        exit(-102);
+      }
+    }
+    for ( t = 0 ; t < st->threads ; t++ )  {
+      pthread_join(workers[t].thread, NULL);
+      failed |= workers[t].failed;
+    }
+  }
+
+  st->end = now();
+
+  if ( !failed )  {
+    /* time lost to imbalance: threads that finished before the stage did */
+    for ( t = 0 ; t < st->threads ; t++ )  {
+      st->busy += workers[t].end - st->start;
+      st->idle += st->end - workers[t].end;
+    }
+  }
+  if ( workers ) free(workers);
+
+  pthread_mutex_lock(&dag_mutex);
+  st->failed = failed;
+  st->done = 1;
+  pthread_cond_broadcast(&dag_cond);
+  pthread_mutex_unlock(&dag_mutex);
+
+  return NULL;
+}
+
+/* Read this thread's share of the input files, then write its share of the outputs. */
+void *stage_worker(void *arg){
+
+  struct stage_worker *me = (struct stage_worker *) arg;
+  struct stage *st = me->stage;
+  struct stage *dep;
+  char name[PATH_MAX];
+  char *data;
+  int d = 0, i = 0, k = 0;
+
+  data = (char *) malloc(MB);
+  if ( !data )  {
+    fprintf(stderr, "ERROR: out of memory in stage %s\n", st->name);
+    me->failed = 1;
+    return NULL;
+  }
+  memset(data, '6', MB);
+
+  /* number the input files across all dependencies so they are shared evenly */
+  for ( d = 0 ; d < st->n_deps ; d++ )  {
+    dep = &stages[st->deps[d]];
+    for ( i = 0 ; i < dep->n_files ; i++, k++ )  {
+      if ( k % st->threads != me->id ) continue;
+      stage_file(dep, i, name, sizeof(name));
+      if ( read_file(name, data, MB, dep->size_mb, backend) != 0 ) me->failed = 1;
+    }
+  }
+
+  for ( i = me->id ; i < st->n_files ; i += st->threads )  {
+    stage_file(st, i, name, sizeof(name));
+    if ( write_file(name, data, MB, st->size_mb, backend) != 0 ) me->failed = 1;
+  }
+
+  free(data);
+  me->end = now();
+  return NULL;
+}
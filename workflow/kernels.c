@@ -0,0 +1,145 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "kernels.h"
+
+int backend_from_name(char *name){
+
+  if ( strcmp(name, "posix") == 0 ) return BACKEND_POSIX;
+  if ( strcmp(name, "mmap") == 0 ) return BACKEND_MMAP;
+
+  return -1;
+}
+
+char *backend_name(int backend){
+
+  return backend == BACKEND_MMAP ? "mmap" : "posix";
+}
+
+/*
+ * Write chunks copies of the chunk_bytes long buffer data to the file name
+ * and make them durable before returning. The POSIX backend uses write and
+ * fsync, the mmap backend copies into a shared mapping and uses msync, which
+ * is the path taken on a DAX (pmem-backed) filesystem.
+ */
+int write_file(char *name, char *data, long int chunk_bytes, int chunks, int backend){
+
+  char *addr = NULL;
+  size_t len = (size_t) chunk_bytes * chunks;
+  int fd = 0, j = 0;
+
+  if ( backend == BACKEND_MMAP )  {
+    fd = open(name, O_CREAT|O_RDWR|O_TRUNC, 0644);
+  }else{
+    fd = open(name, O_CREAT|O_WRONLY|O_TRUNC|O_APPEND, 0644);
+  }
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: unable to open %s for writing\n", name);
+    return 1;
+  }
+
+  if ( backend == BACKEND_MMAP )  {
+    if ( len > 0 )  {
+      if ( ftruncate(fd, len) != 0 )  {
+        fprintf(stderr, "ERROR: unable to size %s for writing\n", name);
+        close(fd);
+        return 1;
+      }
+      addr = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+      if ( addr == MAP_FAILED )  {
+        fprintf(stderr, "ERROR: unable to map %s for writing\n", name);
+        close(fd);
+        return 1;
+      }
+
+      /* loop over chunks */
+      for(j=0; j<chunks; j++){
+        memcpy(addr + (size_t) j * chunk_bytes, data, chunk_bytes);
+      }
+
+      msync(addr, len, MS_SYNC);
+      munmap(addr, len);
+    }
+  }else{
+
+    /* loop over chunks */
+    for(j=0; j<chunks; j++){
+      if ( write(fd, data, chunk_bytes) != chunk_bytes )  {
+        fprintf(stderr, "ERROR: short write to %s\n", name);
+        close(fd);
+        return 1;
+      }
+    }
+
+    fsync(fd);
+  }
+
+  close(fd);
+  return 0;
+}
+
+/*
+ * Read chunks chunks of chunk_bytes from the file name into data, which is
+ * reused for every chunk.
+ */
+int read_file(char *name, char *data, long int chunk_bytes, int chunks, int backend){
+
+  char *addr = NULL;
+  size_t len = (size_t) chunk_bytes * chunks;
+  int fd = 0, j = 0;
+
+  fd = open(name, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: unable to open %s for reading\n", name);
+    return 1;
+  }
+
+  if ( backend == BACKEND_MMAP )  {
+    if ( len > 0 )  {
+      addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+      if ( addr == MAP_FAILED )  {
+        fprintf(stderr, "ERROR: unable to map %s for reading\n", name);
+        close(fd);
+        return 1;
+      }
+
+      /* loop over chunks */
+      for(j=0; j<chunks; j++){
+        memcpy(data, addr + (size_t) j * chunk_bytes, chunk_bytes);
+      }
+
+      munmap(addr, len);
+    }
+  }else{
+
+    /* loop over chunks */
+    for(j=0; j<chunks; j++){
+      if ( read(fd, data, chunk_bytes) != chunk_bytes )  {
+        fprintf(stderr, "ERROR: short read from %s\n", name);
+        close(fd);
+        return 1;
+      }
+    }
+
+    fsync(fd);
+  }
+
+  close(fd);
+  return 0;
+}
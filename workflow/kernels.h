@@ -0,0 +1,17 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+/* File I/O kernels shared by the producer, consumer and workflow driver */
+
+#define BACKEND_POSIX 0
+#define BACKEND_MMAP 1
+
+int backend_from_name(char *);
+char *backend_name(int);
+int write_file(char *, char *, long int, int, int);
+int read_file(char *, char *, long int, int, int);
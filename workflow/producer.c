@@ -20,6 +20,7 @@
 #include <math.h>
 
 #include "utils.h"
+#include "kernels.h"
 
 int main(int argc, char **argv){
   struct timespec start, end;
@@ -28,11 +29,10 @@ int main(int argc, char **argv){
   char name[100] = "";
   int size = 0;
   char *data = NULL;
-  int N = 0, i = 0, j = 0, rep = 0;
+  int N = 0, i = 0, rep = 0;
   int n_files = 0;
 
   char titlebuffer[500] = "";
-  int fd = 0;
 
   /* allocate and initialise data */
   N = pow(1024,2);
@@ -68,19 +68,9 @@ int main(int argc, char **argv){
     strcpy(name,path);
     sprintf(name+strlen(name), "_%d", i);
     
-    fd = open(name, O_CREAT|O_WRONLY|O_TRUNC|O_APPEND, 0644);
-    if (fd < 0) {
-      fprintf(stderr, "ERROR: unable to open testfile for writing\n");
+    if ( write_file(name, data, N*size, rep, BACKEND_POSIX) != 0 )  {
       return 1;
     }
-    
-    /* loop over chunks */
-    for(j=0; j<rep; j++){
-      write(fd, data, N*size);
-    }
-
-    fsync(fd);
-    close(fd);
   }
 
   clock_gettime(CLOCK_MONOTONIC, &end);
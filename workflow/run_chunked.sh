@@ -0,0 +1,13 @@
+# $1 = field dimensions, e.g. 512x512x512
+# $2 = chunk dimensions, e.g. 64x64x64
+# $3 = number of files
+# $4 = path to write/read the files
+# $5 = region to read selectively, e.g. 0:64,0:512,0:512
+# $6 = posix or mmap
+./chunk_producer $1 $2 $3 $4 $6
+sleep 1
+time sudo sync
+sleep 1
+time echo 3 | sudo tee /proc/sys/vm/drop_caches
+sleep 1
+./chunk_consumer $3 $4 $5 $6
@@ -0,0 +1,337 @@
+/* Copyright (c) 2017 The University of Edinburgh. */
+
+/*
+* This software was developed as part of the
+* EC H2020 funded project NEXTGenIO (Project ID: 671951)
+* www.nextgenio.eu
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/sysmacros.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <sched.h>
+#include <pthread.h>
+#include <libpmem.h>
+
+#include "utils.h"
+
+/*
+ * Multi-threaded version of the producer. Each file is still filled with
+ * 1MB chunks using pmem_memcpy_nodrain, but the chunks are shared out
+ * between T threads, either by splitting every file into T pieces ("split")
+ * or by handing whole files to threads round-robin ("files"). Every thread
+ * issues a single pmem_drain once it has copied all of its chunks.
+ *
+ * The run is repeated for T = 1, 2, 4, ... max_threads so the write bandwidth
+ * scaling can be read straight off the output.
+ *
+ * PMEM_IS_PMEM_FORCE=1 ./producer_threads 10 2 /mnt/pmem0 8 split auto
+ */
+
+#define MAX_FILES 4096
+#define MAX_CPUS 4096
+
+#define MODE_SPLIT 0
+#define MODE_FILES 1
+
+struct producer_thread {
+  pthread_t thread;
+  int id;
+  int cpu;
+};
+
+static char *pmemaddrs[MAX_FILES];
+static char *data = NULL;
+static int chunk_bytes = 0;
+static int rep = 0;
+static int n_files = 0;
+static int n_threads = 0;
+static int mode = MODE_SPLIT;
+static pthread_barrier_t start_barrier, end_barrier;
+
+int node_of_path(char *);
+int node_cpus(int, int *, int);
+int parse_cpulist(char *, int *, int);
+void *producer_worker(void *);
+
+int main(int argc, char **argv){
+  struct timespec start, end, elapsed;
+
+  char *path;
+  char name[PATH_MAX] = "";
+  int i = 0, t = 0, max_threads = 0, is_pmem = 0;
+  int node = -1, n_cpus = 0;
+  int cpus[MAX_CPUS];
+  size_t mapped_len[MAX_FILES];
+  double duration = 0, base_bw = 0, bw = 0;
+  unsigned long total_bytes = 0;
+  struct producer_thread *threads;
+
+  if ( argc < 5 || argc > 7 )  {
+    fprintf(stderr, "ERROR: incorrect usage (repetitions number_of_files path max_threads [split|files] [numa_node|auto|none]).\n");
+    return -10;
+  }
+
+  rep = atoi(argv[1]);
+  n_files = atoi(argv[2]);
+  path = argv[3];
+  max_threads = atoi(argv[4]);
+
+  if ( rep < 1 || n_files < 1 || n_files > MAX_FILES || max_threads < 1 )  {
+    fprintf(stderr, "ERROR: repetitions, max_threads must be positive and number_of_files between 1 and %d.\n", MAX_FILES);
+    return -10;
+  }
+
+  if ( argc > 5 )  {
+    if ( strcmp(argv[5], "split") == 0 )  {
+      mode = MODE_SPLIT;
+    }else if ( strcmp(argv[5], "files") == 0 )  {
+      mode = MODE_FILES;
+    }else{
+      fprintf(stderr, "ERROR: unknown distribution %s (use split or files).\n", argv[5]);
+      return -10;
+    }
+  }
+
+  /* work out which cpus the threads should be pinned to */
+  if ( argc > 6 && strcmp(argv[6], "none") != 0 )  {
+    if ( strcmp(argv[6], "auto") == 0 )  {
+      node = node_of_path(path);
+      if ( node < 0 )  {
+        printf("Unable to find the NUMA node owning %s, not restricting threads to a node\n", path);
+      }
+    }else{
+      node = atoi(argv[6]);
+    }
+  }
+  n_cpus = node_cpus(node, cpus, MAX_CPUS);
+  if ( n_cpus < 1 )  {
+    fprintf(stderr, "ERROR: unable to find any cpus for NUMA node %d.\n", node);
+    return -10;
+  }
+
+  /* allocate and initialise data, same 1MB pattern as the serial producer */
+  chunk_bytes = pow(1024,2);
+  data = (char*) malloc(chunk_bytes);
+  threads = (struct producer_thread *) malloc(max_threads * sizeof(struct producer_thread));
+  if ( !data || !threads )  {
+    fprintf(stderr, "ERROR: out of memory in producer_threads\n");
+    return -1;
+  }
+  memset(data, '6', chunk_bytes);
+  memset(&data[0], '1', 1);
+  memset(&data[chunk_bytes - 1], '1', 1);
+
+  total_bytes = (unsigned long) n_files * rep * chunk_bytes;
+
+  printf("Writing %d files of %lu bytes to directory %s with up to %d threads (%s distribution)\n",
+         n_files, (unsigned long) rep * chunk_bytes, path, max_threads, mode == MODE_SPLIT ? "split" : "files");
+  if ( node >= 0 )  {
+    printf("Pinning threads to the %d cpus of NUMA node %d\n", n_cpus, node);
+  }else{
+    printf("Pinning threads to the %d cpus available to the process\n", n_cpus);
+  }
+
+  printf("\n--- Write bandwidth scaling ---------------------------------------------------------\n");
+  printf("|\n");
+  printf("| %8s %16s %16s %10s\n", "Threads", "Duration (s)", "Bandwidth MB/s", "Speedup");
+
+  for ( n_threads = 1 ; ; n_threads *= 2 )  {
+
+    if ( n_threads > max_threads ) n_threads = max_threads;
+
+    /* create and map all of the files up front so only the copies are timed */
+    for ( i = 0 ; i < n_files ; i++ )  {
+      snprintf(name, sizeof(name), "%s/testfile_%d", path, i);
+      unlink(name);
+
+      if ((pmemaddrs[i] = pmem_map_file(name, (size_t) rep * chunk_bytes,
+                               PMEM_FILE_CREATE|PMEM_FILE_EXCL,
+                               0666, &mapped_len[i], &is_pmem)) == NULL) {
+                                    perror("pmem_map_file");
+                                    fprintf(stderr, "Failed to pmem_map_file for filename:%s.\n", name);
+                                    exit(-100);
+                                  }
+
+      if ( !is_pmem )  {
+        printf("Not pmem\n");
+        exit(-101);
+      }
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, n_threads + 1);
+    pthread_barrier_init(&end_barrier, NULL, n_threads + 1);
+
+    for ( t = 0 ; t < n_threads ; t++ )  {
+      threads[t].id = t;
+      threads[t].cpu = cpus[t % n_cpus];
+      if ( pthread_create(&threads[t].thread, NULL, producer_worker, &threads[t]) != 0 )  {
+        fprintf(stderr, "ERROR: unable to create producer thread %d\n", t);
+        exit(-102);
+      }
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_barrier_wait(&end_barrier);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for ( t = 0 ; t < n_threads ; t++ )  {
+      pthread_join(threads[t].thread, NULL);
+    }
+    pthread_barrier_destroy(&start_barrier);
+    pthread_barrier_destroy(&end_barrier);
+
+    for ( i = 0 ; i < n_files ; i++ )  {
+      pmem_unmap(pmemaddrs[i], mapped_len[i]);
+    }
+
+    sub_time_hr(&elapsed, &start, &end);
+    duration = elapsed.tv_sec + ((double)elapsed.tv_nsec/1000000000);
+    bw = (total_bytes / (1024.0 * 1024.0)) / duration;
+    if ( n_threads == 1 ) base_bw = bw;
+
+    printf("| %8d %16.9lf %16.3lf %10.2lf\n", n_threads, duration, bw, bw / base_bw);
+    fflush(stdout);
+
+    if ( n_threads == max_threads ) break;
+  }
+
+  printf("|\n");
+  printf("------------------------------------------------------------------------------------\n");
+
+  free(threads);
+  free(data);
+  fflush(stdout);
+  return 0;
+}
+
+/* Copy this thread's share of the chunks, then drain once. */
+void *producer_worker(void *arg){
+
+  struct producer_thread *me = (struct producer_thread *) arg;
+  cpu_set_t cpuset;
+  int i = 0, j = 0, first = 0, last = 0;
+
+  CPU_ZERO(&cpuset);
+  CPU_SET(me->cpu, &cpuset);
+  if ( pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0 )  {
+    fprintf(stderr, "WARNING: unable to pin thread %d to cpu %d\n", me->id, me->cpu);
+  }
+
+  pthread_barrier_wait(&start_barrier);
+
+  if ( mode == MODE_SPLIT )  {
+    /* every thread takes a contiguous range of the chunks of every file */
+    first = ((long) rep * me->id) / n_threads;
+    last = ((long) rep * (me->id + 1)) / n_threads;
+    for ( i = 0 ; i < n_files ; i++ )  {
+      for ( j = first ; j < last ; j++ )  {
+        pmem_memcpy_nodrain(pmemaddrs[i] + (size_t) j * chunk_bytes, data, chunk_bytes);
+      }
+    }
+  }else{
+    /* whole files are handed out round-robin */
+    for ( i = me->id ; i < n_files ; i += n_threads )  {
+      for ( j = 0 ; j < rep ; j++ )  {
+        pmem_memcpy_nodrain(pmemaddrs[i] + (size_t) j * chunk_bytes, data, chunk_bytes);
+      }
+    }
+  }
+
+  pmem_drain();
+
+  pthread_barrier_wait(&end_barrier);
+
+  return NULL;
+}
+
+/*
+ * Find the NUMA node owning the block device (pmem namespace) that holds
+ * path, returns -1 if it cannot be determined.
+ */
+int node_of_path(char *path){
+
+  struct stat sb;
+  char sysname[PATH_MAX];
+  FILE *fp;
+  int node = -1;
+
+  if ( stat(path, &sb) != 0 ) return -1;
+
+  /* a whole namespace (pmem0) first, then the parent of a partition (pmem0p1) */
+  snprintf(sysname, sizeof(sysname), "/sys/dev/block/%u:%u/device/numa_node", major(sb.st_dev), minor(sb.st_dev));
+  fp = fopen(sysname, "r");
+  if ( !fp )  {
+    snprintf(sysname, sizeof(sysname), "/sys/dev/block/%u:%u/../device/numa_node", major(sb.st_dev), minor(sb.st_dev));
+    fp = fopen(sysname, "r");
+  }
+  if ( !fp ) return -1;
+
+  if ( fscanf(fp, "%d", &node) != 1 ) node = -1;
+  fclose(fp);
+
+  return node;
+}
+
+/*
+ * Fill cpus with the cpus of the given NUMA node, or with all of the cpus
+ * this process may run on if node is negative. Returns the number found.
+ */
+int node_cpus(int node, int *cpus, int max_cpus){
+
+  char sysname[PATH_MAX];
+  char cpulist[4096];
+  cpu_set_t cpuset;
+  FILE *fp;
+  int i = 0, n = 0;
+
+  if ( node >= 0 )  {
+    snprintf(sysname, sizeof(sysname), "/sys/devices/system/node/node%d/cpulist", node);
+    fp = fopen(sysname, "r");
+    if ( !fp ) return 0;
+    if ( !fgets(cpulist, sizeof(cpulist), fp) )  {
+      fclose(fp);
+      return 0;
+    }
+    fclose(fp);
+    return parse_cpulist(cpulist, cpus, max_cpus);
+  }
+
+  CPU_ZERO(&cpuset);
+  if ( sched_getaffinity(0, sizeof(cpu_set_t), &cpuset) != 0 ) return 0;
+  for ( i = 0 ; i < CPU_SETSIZE && n < max_cpus ; i++ )  {
+    if ( CPU_ISSET(i, &cpuset) ) cpus[n++] = i;
+  }
+
+  return n;
+}
+
+/* Parse a sysfs cpu list such as "0-17,36-53". */
+int parse_cpulist(char *list, int *cpus, int max_cpus){
+
+  char *tok, *saveptr = NULL;
+  int lo = 0, hi = 0, i = 0, n = 0;
+
+  for ( tok = strtok_r(list, ",\n", &saveptr) ; tok ; tok = strtok_r(NULL, ",\n", &saveptr) )  {
+    if ( sscanf(tok, "%d-%d", &lo, &hi) != 2 )  {
+      if ( sscanf(tok, "%d", &lo) != 1 ) continue;
+      hi = lo;
+    }
+    for ( i = lo ; i <= hi && n < max_cpus ; i++ )  {
+      cpus[n++] = i;
+    }
+  }
+
+  return n;
+}